@@ -0,0 +1,413 @@
+//
+//  bench.c
+//  pd-keyboard
+//
+//  Created by agent on 16/10/2026.
+//
+
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pd_stub.h"
+#include "keyboard.h"
+
+typedef struct {
+    PDStub * _Nonnull stub;
+    PDKeyboard * _Nonnull keyboard;
+    char * _Nullable text;
+    unsigned int textLength;
+    unsigned int frame;
+} PDBenchContext;
+
+typedef void PDBenchStep(PDBenchContext * _Nonnull context, unsigned int frame);
+
+typedef struct {
+    const char * _Nonnull name;
+    float refreshRate;
+    unsigned int frameCount;
+    /// Length of the text given to show(), filled with letters.
+    unsigned int textLength;
+    /// Frames run after show() and before the measures begin. 0 to start with a hidden keyboard.
+    unsigned int openFrames;
+    /// Called before each frame to set the buttons and crank.
+    PDBenchStep * _Nullable input;
+    /// Called from the app update callback, like a game would call the keyboard API.
+    PDBenchStep * _Nullable update;
+    /// Enables idle frames with setIdleBehavior, the app update then returns 0 as if it didn't draw anything.
+    unsigned int idleFrameCount;
+    PDKeyboardSlideStyle slideStyle;
+} PDBenchScenario;
+
+typedef enum {
+    kMetricNanoseconds,
+    kMetricCalls,
+    kMetricAllocations,
+} PDBenchMetric;
+#define kMetricCount 3
+
+static const char * _Nonnull metricNames[kMetricCount] = {"ns/frame", "calls/frame", "allocs/frame"};
+
+typedef struct {
+    unsigned long p50[kMetricCount];
+    unsigned long p99[kMetricCount];
+} PDBenchResult;
+
+#pragma mark - Scenarios
+
+static void idleStep(PDBenchContext * _Nonnull context, unsigned int frame) {
+    PDStubSetButtons(context->stub, 0);
+}
+
+/// @brief Select the symbols column then hold up through the 42 symbols.
+static void holdUpStep(PDBenchContext * _Nonnull context, unsigned int frame) {
+    if (frame == 0) {
+        PDStubSetButtons(context->stub, kButtonLeft);
+    } else if (frame == 1) {
+        PDStubSetButtons(context->stub, 0);
+    } else {
+        PDStubSetButtons(context->stub, kButtonUp);
+    }
+}
+
+/// @brief Fast crank spins, changing direction every 2 seconds.
+static void crankStep(PDBenchContext * _Nonnull context, unsigned int frame) {
+    const float direction = (frame / 60) % 2 == 0 ? 1.0f : -1.0f;
+    PDStubSetCrankChange(context->stub, direction * (40.0f + (frame % 7) * 10.0f));
+}
+
+static void showHideStep(PDBenchContext * _Nonnull context, unsigned int frame) {
+    switch (frame % 40) {
+        case 0:
+            keyboardApi.show(context->keyboard, context->text, context->textLength);
+            break;
+        case 20:
+            keyboardApi.hide(context->keyboard);
+            break;
+        default:
+            break;
+    }
+}
+
+/// @brief Type letters with quick A taps, then delete them by holding B.
+static void typeAndDeleteStep(PDBenchContext * _Nonnull context, unsigned int frame) {
+    const unsigned int cycleFrame = frame % 300;
+    if (cycleFrame < 150) {
+        PDStubSetButtons(context->stub, cycleFrame % 4 < 2 ? kButtonA : 0);
+    } else {
+        PDStubSetButtons(context->stub, kButtonB);
+    }
+}
+
+static const PDBenchScenario scenarios[] = {
+    {
+        .name = "idle",
+        .refreshRate = 30.0f,
+        .frameCount = 300,
+        .openFrames = 15,
+        .input = idleStep,
+    },
+    {
+        .name = "idle-skipped",
+        .refreshRate = 30.0f,
+        .frameCount = 300,
+        .openFrames = 15,
+        .input = idleStep,
+        .idleFrameCount = 10,
+    },
+    {
+        .name = "hold-up-symbols",
+        .refreshRate = 30.0f,
+        .frameCount = 300,
+        .openFrames = 15,
+        .input = holdUpStep,
+    },
+    {
+        .name = "crank-spin",
+        .refreshRate = 30.0f,
+        .frameCount = 300,
+        .openFrames = 15,
+        .input = crankStep,
+    },
+    {
+        .name = "show-hide-30fps",
+        .refreshRate = 30.0f,
+        .frameCount = 400,
+        .textLength = 16,
+        .update = showHideStep,
+    },
+    {
+        .name = "show-hide-50fps",
+        .refreshRate = 50.0f,
+        .frameCount = 400,
+        .textLength = 16,
+        .update = showHideStep,
+    },
+    {
+        .name = "show-hide-solid",
+        .refreshRate = 30.0f,
+        .frameCount = 400,
+        .textLength = 16,
+        .update = showHideStep,
+        .slideStyle = kSlideStyleSolid,
+    },
+    {
+        .name = "type-delete-10k",
+        .refreshRate = 30.0f,
+        .frameCount = 600,
+        .textLength = 10000,
+        .openFrames = 15,
+        .input = typeAndDeleteStep,
+    },
+};
+#define kScenarioCount (sizeof(scenarios) / sizeof(PDBenchScenario))
+
+#pragma mark - Measures
+
+static const PDBenchScenario * _Nullable currentScenario;
+
+static int hostUpdate(void * _Nonnull userdata) {
+    PDBenchContext *context = userdata;
+    if (currentScenario->update) {
+        currentScenario->update(context, context->frame);
+    }
+    return currentScenario->idleFrameCount == 0;
+}
+
+static unsigned long nanoseconds(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1000000000UL + time.tv_nsec;
+}
+
+static int compareSamples(const void * _Nonnull lhs, const void * _Nonnull rhs) {
+    const unsigned long a = *(const unsigned long *) lhs;
+    const unsigned long b = *(const unsigned long *) rhs;
+    return a < b ? -1 : a > b;
+}
+
+static unsigned long percentile(unsigned long * _Nonnull samples, unsigned int count, unsigned int percent) {
+    qsort(samples, count, sizeof(unsigned long), compareSamples);
+    const unsigned int index = (count * percent + 99) / 100;
+    return samples[index > 0 ? index - 1 : 0];
+}
+
+/// @brief Runs the scenario <em>repeat</em> times. Counts are taken from the first run, timings are the
+/// lowest percentiles of all runs so that a run disturbed by the system doesn't count as a regression.
+static PDBenchResult runScenario(const PDBenchScenario * _Nonnull scenario, unsigned int repeat) {
+    const unsigned int frameCount = scenario->frameCount;
+    unsigned long *samples[kMetricCount];
+    for (unsigned int metric = 0; metric < kMetricCount; metric++) {
+        samples[metric] = malloc(sizeof(unsigned long) * frameCount);
+    }
+    PDBenchResult result = {};
+
+    const unsigned int frameDuration = 1000 / scenario->refreshRate;
+    for (unsigned int run = 0; run < repeat; run++) {
+        PDStub *stub = PDStubNew();
+        PDStubMakeCurrent(stub);
+        PDStubSetRasterEnabled(stub, 0);
+        PDStubSetTime(stub, 1000);
+
+        PDBenchContext context = {
+            .stub = stub,
+            .keyboard = keyboardApi.newKeyboard(),
+            .textLength = scenario->textLength,
+        };
+        context.text = malloc(context.textLength + 1);
+        for (unsigned int index = 0; index < context.textLength; index++) {
+            context.text[index] = 'a' + index % 26;
+        }
+        context.text[context.textLength] = '\0';
+
+        currentScenario = scenario;
+        keyboardApi.setPlaydateUpdateCallback(context.keyboard, hostUpdate, &context);
+        keyboardApi.setRefreshRate(context.keyboard, scenario->refreshRate);
+        keyboardApi.setIdleBehavior(context.keyboard, scenario->idleFrameCount, scenario->idleFrameCount ? 10.0f : 0.0f);
+        keyboardApi.setSlideStyle(context.keyboard, scenario->slideStyle);
+        playdate->system->setUpdateCallback(hostUpdate, &context);
+        if (scenario->openFrames > 0) {
+            keyboardApi.show(context.keyboard, context.text, context.textLength);
+            for (unsigned int frame = 0; frame < scenario->openFrames; frame++) {
+                PDStubAdvanceTime(stub, frameDuration);
+                PDStubRunFrame(stub);
+            }
+        }
+
+        for (unsigned int frame = 0; frame < frameCount; frame++) {
+            context.frame = frame;
+            if (scenario->input) {
+                scenario->input(&context, frame);
+            }
+            PDStubAdvanceTime(stub, frameDuration);
+            const unsigned long start = nanoseconds();
+            PDStubRunFrame(stub);
+            samples[kMetricNanoseconds][frame] = nanoseconds() - start;
+            samples[kMetricCalls][frame] = PDStubGetFrameCallCount(stub);
+            samples[kMetricAllocations][frame] = PDStubGetAllocationCount(stub);
+        }
+
+        keyboardApi.freeKeyboard(context.keyboard);
+        free(context.text);
+        PDStubFree(stub);
+
+        const unsigned long p50 = percentile(samples[kMetricNanoseconds], frameCount, 50);
+        const unsigned long p99 = percentile(samples[kMetricNanoseconds], frameCount, 99);
+        if (run == 0 || p50 < result.p50[kMetricNanoseconds]) {
+            result.p50[kMetricNanoseconds] = p50;
+        }
+        if (run == 0 || p99 < result.p99[kMetricNanoseconds]) {
+            result.p99[kMetricNanoseconds] = p99;
+        }
+        if (run == 0) {
+            for (unsigned int metric = kMetricCalls; metric < kMetricCount; metric++) {
+                result.p50[metric] = percentile(samples[metric], frameCount, 50);
+                result.p99[metric] = percentile(samples[metric], frameCount, 99);
+            }
+        }
+    }
+    for (unsigned int metric = 0; metric < kMetricCount; metric++) {
+        free(samples[metric]);
+    }
+    return result;
+}
+
+#pragma mark - Baseline
+
+static int readBaseline(FILE * _Nonnull file, const char * _Nonnull name, PDBenchResult * _Nonnull result) {
+    rewind(file);
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        char scenarioName[64];
+        PDBenchResult entry;
+        if (line[0] == '#' || sscanf(line, "%63s %lu %lu %lu %lu %lu %lu", scenarioName,
+                                     &entry.p50[kMetricNanoseconds], &entry.p99[kMetricNanoseconds],
+                                     &entry.p50[kMetricCalls], &entry.p99[kMetricCalls],
+                                     &entry.p50[kMetricAllocations], &entry.p99[kMetricAllocations]) != 7) {
+            continue;
+        }
+        if (strcmp(scenarioName, name) == 0) {
+            *result = entry;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void writeBaseline(FILE * _Nonnull file, const char * _Nonnull name, PDBenchResult result) {
+    fprintf(file, "%s %lu %lu %lu %lu %lu %lu\n", name,
+            result.p50[kMetricNanoseconds], result.p99[kMetricNanoseconds],
+            result.p50[kMetricCalls], result.p99[kMetricCalls],
+            result.p50[kMetricAllocations], result.p99[kMetricAllocations]);
+}
+
+/// @brief Counts are deterministic and must not grow, timings may vary by <em>timeThreshold</em> percent.
+static int isRegression(PDBenchMetric metric, unsigned long value, unsigned long baseline, unsigned int timeThreshold) {
+    if (metric != kMetricNanoseconds) {
+        return value > baseline;
+    }
+    // Small absolute slack so that very cheap frames don't fail on timer noise.
+    const unsigned long slack = 100;
+    return value > baseline + baseline * timeThreshold / 100 + slack;
+}
+
+static void usage(const char * _Nonnull name) {
+    fprintf(stderr, "usage: %s [-r repeat] [-t time threshold %%] [-c baseline | -w baseline] [scenario...]\n", name);
+    fprintf(stderr, "Replays keyboard scenarios and prints p50/p99 of ns, API calls and allocations per frame.\n");
+    fprintf(stderr, "  -c  compare with the given baseline, exit with 1 if a metric regressed\n");
+    fprintf(stderr, "  -w  write the results to the given baseline file\n");
+    fprintf(stderr, "  -t  allowed ns/frame increase in percent, defaults to 25. Counts must not increase.\n");
+}
+
+int main(int argc, char * _Nonnull argv[]) {
+    unsigned int repeat = 10;
+    unsigned int timeThreshold = 25;
+    const char *comparePath = NULL;
+    const char *writePath = NULL;
+
+    int option;
+    while ((option = getopt(argc, argv, "r:t:c:w:h")) != -1) {
+        switch (option) {
+            case 'r':
+                repeat = (unsigned int) atoi(optarg);
+                break;
+            case 't':
+                timeThreshold = (unsigned int) atoi(optarg);
+                break;
+            case 'c':
+                comparePath = optarg;
+                break;
+            case 'w':
+                writePath = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return option == 'h' ? 0 : 1;
+        }
+    }
+    if (repeat == 0 || (comparePath && writePath)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    FILE *baseline = NULL;
+    if (comparePath || writePath) {
+        baseline = fopen(comparePath ? comparePath : writePath, comparePath ? "r" : "w");
+        if (baseline == NULL) {
+            perror(comparePath ? comparePath : writePath);
+            return 1;
+        }
+        if (writePath) {
+            fprintf(baseline, "# scenario ns/frame(p50 p99) calls/frame(p50 p99) allocs/frame(p50 p99)\n");
+        }
+    }
+
+    printf("%-18s %10s %10s %9s %8s %10s %8s\n", "scenario", "ns p50", "ns p99", "calls p50", "p99", "allocs p50", "p99");
+    int regressionCount = 0;
+    for (unsigned int index = 0; index < kScenarioCount; index++) {
+        const PDBenchScenario *scenario = &scenarios[index];
+        if (optind < argc) {
+            int selected = 0;
+            for (int argument = optind; argument < argc; argument++) {
+                selected |= strcmp(argv[argument], scenario->name) == 0;
+            }
+            if (!selected) {
+                continue;
+            }
+        }
+
+        const PDBenchResult result = runScenario(scenario, repeat);
+        printf("%-18s %10lu %10lu %9lu %8lu %10lu %8lu\n", scenario->name,
+               result.p50[kMetricNanoseconds], result.p99[kMetricNanoseconds],
+               result.p50[kMetricCalls], result.p99[kMetricCalls],
+               result.p50[kMetricAllocations], result.p99[kMetricAllocations]);
+
+        if (writePath) {
+            writeBaseline(baseline, scenario->name, result);
+            continue;
+        }
+        PDBenchResult expected;
+        if (comparePath == NULL) {
+            continue;
+        }
+        if (!readBaseline(baseline, scenario->name, &expected)) {
+            fprintf(stderr, "%s: no baseline\n", scenario->name);
+            continue;
+        }
+        for (unsigned int metric = 0; metric < kMetricCount; metric++) {
+            const unsigned long *values[2] = {result.p50, result.p99};
+            const unsigned long *baselines[2] = {expected.p50, expected.p99};
+            for (int percentile = 0; percentile < 2; percentile++) {
+                if (isRegression(metric, values[percentile][metric], baselines[percentile][metric], timeThreshold)) {
+                    fprintf(stderr, "%s: %s %s regressed, %lu > %lu\n", scenario->name, metricNames[metric],
+                            percentile == 0 ? "p50" : "p99", values[percentile][metric], baselines[percentile][metric]);
+                    regressionCount++;
+                }
+            }
+        }
+    }
+    if (baseline) {
+        fclose(baseline);
+    }
+    return regressionCount > 0;
+}
@@ -0,0 +1,171 @@
+//
+//  frames.c
+//  pd-keyboard
+//
+//  Created by agent on 16/10/2026.
+//
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "pd_stub.h"
+#include "keyboard.h"
+
+static int hostUpdate(void * _Nullable userdata) {
+    playdate->graphics->clear(kColorWhite);
+    return 1;
+}
+
+static void printStats(PDKeyboard * _Nonnull keyboard) {
+    PDKeyboardStats stats;
+    if (!keyboardApi.getStats(keyboard, &stats)) {
+        printf("stats: not available, build with STATS=1\n");
+        return;
+    }
+    static const char * _Nonnull phaseNames[kKeyboardPhaseCount] = {"enterNewLetter", "animation", "input", "playdateUpdate", "draw"};
+    printf("stats of the last %u frames: %16s %10s %10s\n", stats.frameCount, "min", "avg", "max");
+    for (unsigned int phase = 0; phase < kKeyboardPhaseCount; phase++) {
+        const PDKeyboardStatValue value = stats.phaseMilliseconds[phase];
+        printf("  %-30s %10.4f %10.4f %10.4f ms\n", phaseNames[phase], value.min, value.average, value.max);
+    }
+    printf("  %-30s %10.4f %10.4f %10.4f ms\n", "frame", stats.frameMilliseconds.min, stats.frameMilliseconds.average, stats.frameMilliseconds.max);
+    printf("  %-30s %10.0f %10.2f %10.0f\n", "text reallocs", stats.textReallocs.min, stats.textReallocs.average, stats.textReallocs.max);
+    printf("  %-30s %10.0f %10.2f %10.0f\n", "sample loads", stats.sampleLoads.min, stats.sampleLoads.average, stats.sampleLoads.max);
+    printf("  %-30s %10.0f %10.2f %10.0f\n", "draw calls", stats.drawCalls.min, stats.drawCalls.average, stats.drawCalls.max);
+    static const float bounds[] = kKeyboardFrameHistogramBounds;
+    printf("  frame histogram:");
+    for (unsigned int bucket = 0; bucket < kKeyboardFrameHistogramSize; bucket++) {
+        if (bucket < kKeyboardFrameHistogramSize - 1) {
+            printf(" <%gms: %u", bounds[bucket], stats.frameHistogram[bucket]);
+        } else {
+            printf(", longer: %u\n", stats.frameHistogram[bucket]);
+        }
+    }
+}
+
+static void usage(const char * _Nonnull name) {
+    fprintf(stderr, "usage: %s [-n frames] [-r refresh rate] [-a asset folder] [-t] [-w hashes | -c hashes] [-p prefix] [-s]\n", name);
+    fprintf(stderr, "Opens the keyboard and prints the PlaydateAPI calls made by each keyboard update.\n");
+    fprintf(stderr, "  -a  folder containing CoreLibs, defaults to $PLAYDATE_SDK_PATH\n");
+    fprintf(stderr, "  -t  print the argument traces\n");
+    fprintf(stderr, "  -w  write the frame buffer hash of each frame to the given file\n");
+    fprintf(stderr, "  -c  compare the frame buffer hashes with the given file, exit with 1 on mismatch\n");
+    fprintf(stderr, "  -p  write each frame as <prefix><frame>.pbm\n");
+    fprintf(stderr, "  -s  print the keyboard statistics (requires a STATS=1 build)\n");
+}
+
+int main(int argc, char * _Nonnull argv[]) {
+    unsigned int frameCount = 30;
+    float refreshRate = 30.0f;
+    int trace = 0;
+    const char *assetPath = getenv("PLAYDATE_SDK_PATH");
+    const char *hashOutputPath = NULL;
+    const char *hashInputPath = NULL;
+    const char *framePrefix = NULL;
+    int showStats = 0;
+
+    int option;
+    while ((option = getopt(argc, argv, "n:r:a:tw:c:p:sh")) != -1) {
+        switch (option) {
+            case 'n':
+                frameCount = (unsigned int) atoi(optarg);
+                break;
+            case 'r':
+                refreshRate = atof(optarg);
+                break;
+            case 'a':
+                assetPath = optarg;
+                break;
+            case 't':
+                trace = 1;
+                break;
+            case 'w':
+                hashOutputPath = optarg;
+                break;
+            case 'c':
+                hashInputPath = optarg;
+                break;
+            case 'p':
+                framePrefix = optarg;
+                break;
+            case 's':
+                showStats = 1;
+                break;
+            default:
+                usage(argv[0]);
+                return option == 'h' ? 0 : 1;
+        }
+    }
+    if (refreshRate <= 0.0f || (hashOutputPath && hashInputPath)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    FILE *hashFile = NULL;
+    if (hashOutputPath || hashInputPath) {
+        hashFile = fopen(hashOutputPath ? hashOutputPath : hashInputPath, hashOutputPath ? "w" : "r");
+        if (hashFile == NULL) {
+            perror(hashOutputPath ? hashOutputPath : hashInputPath);
+            return 1;
+        }
+    }
+
+    PDStub *stub = PDStubNew();
+    PDStubMakeCurrent(stub);
+    PDStubSetAssetPath(stub, assetPath);
+    PDStubSetTraceEnabled(stub, trace);
+
+    PDKeyboard *keyboard = keyboardApi.newKeyboard();
+    keyboardApi.setPlaydateUpdateCallback(keyboard, hostUpdate, NULL);
+    keyboardApi.setRefreshRate(keyboard, refreshRate);
+    keyboardApi.show(keyboard, NULL, 0);
+
+    const unsigned int frameDuration = 1000 / refreshRate;
+    unsigned long totalCalls = 0;
+    unsigned long totalPixels = 0;
+    unsigned int mismatchCount = 0;
+    for (unsigned int frame = 0; frame < frameCount; frame++) {
+        PDStubAdvanceTime(stub, frameDuration);
+        PDStubRunFrame(stub);
+        PDStubDumpFrame(stub, stdout);
+        totalCalls += PDStubGetFrameCallCount(stub);
+        totalPixels += PDStubGetPixelsWritten(stub);
+
+        const uint64_t hash = PDStubGetFrameHash(stub);
+        if (hashOutputPath) {
+            fprintf(hashFile, "%016" PRIx64 "\n", hash);
+        } else if (hashInputPath) {
+            uint64_t expectedHash;
+            if (fscanf(hashFile, "%" SCNx64, &expectedHash) != 1 || expectedHash != hash) {
+                fprintf(stderr, "frame %u: hash %016" PRIx64 " does not match golden frame\n", PDStubGetFrameIndex(stub), hash);
+                mismatchCount++;
+            }
+        }
+        if (framePrefix) {
+            char path[1024];
+            snprintf(path, sizeof(path), "%s%04u.pbm", framePrefix, PDStubGetFrameIndex(stub));
+            FILE *output = fopen(path, "wb");
+            if (output) {
+                PDStubWriteFrame(stub, output);
+                fclose(output);
+            } else {
+                perror(path);
+            }
+        }
+    }
+    if (frameCount > 0) {
+        printf("average: %.1f calls/frame, %.0f pixels written/frame\n", (double) totalCalls / frameCount, (double) totalPixels / frameCount);
+    }
+    if (hashFile) {
+        fclose(hashFile);
+    }
+    if (showStats) {
+        printStats(keyboard);
+    }
+
+    keyboardApi.freeKeyboard(keyboard);
+    const unsigned int errorCount = PDStubGetErrorCount(stub);
+    PDStubFree(stub);
+    return errorCount > 0 || mismatchCount > 0;
+}
@@ -0,0 +1,422 @@
+//
+//  fuzz.c
+//  pd-keyboard
+//
+//  Created by agent on 16/10/2026.
+//
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pd_stub.h"
+#include "keyboard.h"
+
+typedef enum {
+    kFuzzEventNone,
+    kFuzzEventShow,
+    kFuzzEventHide,
+    kFuzzEventCapitalization,
+    kFuzzEventRefreshRate,
+} PDFuzzEvent;
+
+static const char * _Nonnull eventNames[] = {"", "show", "hide", "capitalization", "refresh rate"};
+
+/// Input of a single frame.
+typedef struct {
+    unsigned long frame;
+    unsigned int time;
+    PDButtons buttons;
+    float crankChange;
+    PDFuzzEvent event;
+    /// Text length for show, behavior for capitalization, rate for refresh rate.
+    unsigned int eventArgument;
+} PDFuzzInput;
+
+#define kMaxHistoryLength 64
+#define kMaxSlowestCount 32
+
+typedef struct {
+    unsigned long nanoseconds;
+    unsigned int worker;
+    uint64_t seed;
+    unsigned int historyLength;
+    PDFuzzInput history[kMaxHistoryLength];
+} PDFuzzSlowFrame;
+
+typedef struct {
+    unsigned long frameCount;
+    unsigned int historyLength;
+    unsigned int slowestCount;
+    int rasterEnabled;
+    const char * _Nullable assetPath;
+    const char * _Nullable recordingPrefix;
+} PDFuzzOptions;
+
+typedef struct {
+    unsigned int index;
+    uint64_t seed;
+    uint64_t state;
+    const PDFuzzOptions * _Nonnull options;
+
+    PDStub * _Nullable stub;
+    PDKeyboard * _Nullable keyboard;
+    float refreshRate;
+    unsigned int hiddenFrames;
+    char text[256];
+
+    PDFuzzInput history[kMaxHistoryLength];
+    unsigned int historyIndex;
+    PDFuzzInput * _Nullable current;
+
+    unsigned long framesRun;
+    unsigned int errorCount;
+    unsigned int maxTextLength;
+    PDFuzzSlowFrame slowest[kMaxSlowestCount];
+    unsigned int slowestCount;
+    PDFuzzSlowFrame firstError;
+} PDFuzzWorker;
+
+#pragma mark - Random inputs
+
+static uint64_t nextRandom(PDFuzzWorker * _Nonnull self) {
+    // xorshift64*
+    uint64_t x = self->state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    self->state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+static unsigned int randomBelow(PDFuzzWorker * _Nonnull self, unsigned int bound) {
+    return (unsigned int) ((nextRandom(self) >> 32) % bound);
+}
+
+static float randomFloat(PDFuzzWorker * _Nonnull self, float min, float max) {
+    return min + (max - min) * (float) (nextRandom(self) >> 40) / (float) (1 << 24);
+}
+
+static const PDButtons buttonChoices[] = {
+    0, 0, 0, kButtonUp, kButtonDown, kButtonLeft, kButtonRight, kButtonA, kButtonB, kButtonUp | kButtonA, kButtonDown | kButtonB,
+};
+
+static void generateInput(PDFuzzWorker * _Nonnull self, PDFuzzInput * _Nonnull input, const PDFuzzInput * _Nonnull previous) {
+    *input = (PDFuzzInput) {
+        .frame = self->framesRun,
+        .buttons = previous->buttons,
+    };
+
+    // Frame duration with some jitter and rare stalls.
+    unsigned int duration = 1000 / self->refreshRate + randomBelow(self, 6);
+    if (randomBelow(self, 1000) == 0) {
+        duration += 500 + randomBelow(self, 2000);
+    }
+    input->time = previous->time + duration;
+
+    if (randomBelow(self, 4) == 0) {
+        const unsigned int choice = randomBelow(self, sizeof(buttonChoices) / sizeof(PDButtons) + 1);
+        input->buttons = choice < sizeof(buttonChoices) / sizeof(PDButtons) ? buttonChoices[choice] : (PDButtons) randomBelow(self, 64);
+    }
+
+    const unsigned int crank = randomBelow(self, 100);
+    if (crank < 2) {
+        // Very fast spins, including several turns in a single frame.
+        input->crankChange = randomFloat(self, 360.0f, 5000.0f) * (randomBelow(self, 2) ? 1.0f : -1.0f);
+    } else if (crank < 20) {
+        input->crankChange = randomFloat(self, -60.0f, 60.0f);
+    }
+
+    if (!keyboardApi.isVisible(self->keyboard)) {
+        if (++self->hiddenFrames > randomBelow(self, 10)) {
+            input->event = kFuzzEventShow;
+            input->eventArgument = randomBelow(self, 8) == 0 ? randomBelow(self, sizeof(self->text)) : randomBelow(self, 16);
+        }
+        return;
+    }
+    const unsigned int event = randomBelow(self, 2000);
+    if (event < 3) {
+        input->event = kFuzzEventHide;
+    } else if (event < 5) {
+        input->event = kFuzzEventCapitalization;
+        input->eventArgument = randomBelow(self, 3);
+    } else if (event < 6) {
+        static const unsigned int rates[] = {20, 30, 40, 50};
+        input->event = kFuzzEventRefreshRate;
+        input->eventArgument = rates[randomBelow(self, 4)];
+    }
+}
+
+#pragma mark - Worker
+
+static void applyEvent(PDFuzzWorker * _Nonnull self, const PDFuzzInput * _Nonnull input) {
+    switch (input->event) {
+        case kFuzzEventShow:
+            self->hiddenFrames = 0;
+            keyboardApi.show(self->keyboard, self->text, input->eventArgument);
+            break;
+        case kFuzzEventHide:
+            keyboardApi.hide(self->keyboard);
+            break;
+        case kFuzzEventCapitalization:
+            keyboardApi.setCapitalizationBehavior(self->keyboard, input->eventArgument);
+            break;
+        case kFuzzEventRefreshRate:
+            self->refreshRate = input->eventArgument;
+            keyboardApi.setRefreshRate(self->keyboard, self->refreshRate);
+            break;
+        default:
+            break;
+    }
+}
+
+static int hostUpdate(void * _Nullable userdata) {
+    PDFuzzWorker *self = userdata;
+    playdate->graphics->clear(kColorWhite);
+    if (self->current) {
+        applyEvent(self, self->current);
+    }
+    return 1;
+}
+
+static void copyHistory(PDFuzzWorker * _Nonnull self, PDFuzzSlowFrame * _Nonnull slowFrame, unsigned long nanoseconds) {
+    const unsigned int length = self->options->historyLength;
+    const unsigned int available = self->framesRun < length ? (unsigned int) self->framesRun : length;
+    *slowFrame = (PDFuzzSlowFrame) {
+        .nanoseconds = nanoseconds,
+        .worker = self->index,
+        .seed = self->seed,
+        .historyLength = available,
+    };
+    for (unsigned int index = 0; index < available; index++) {
+        slowFrame->history[index] = self->history[(self->historyIndex + length - available + index) % length];
+    }
+}
+
+static void keepIfSlowest(PDFuzzWorker * _Nonnull self, unsigned long nanoseconds) {
+    const unsigned int capacity = self->options->slowestCount;
+    if (self->slowestCount == capacity && nanoseconds <= self->slowest[capacity - 1].nanoseconds) {
+        return;
+    }
+    unsigned int index = self->slowestCount < capacity ? self->slowestCount++ : capacity - 1;
+    while (index > 0 && self->slowest[index - 1].nanoseconds < nanoseconds) {
+        self->slowest[index] = self->slowest[index - 1];
+        index--;
+    }
+    copyHistory(self, &self->slowest[index], nanoseconds);
+}
+
+static unsigned long elapsedNanoseconds(const struct timespec * _Nonnull start, const struct timespec * _Nonnull end) {
+    return (end->tv_sec - start->tv_sec) * 1000000000UL + end->tv_nsec - start->tv_nsec;
+}
+
+static void * _Nullable runWorker(void * _Nonnull userdata) {
+    PDFuzzWorker *self = userdata;
+    const PDFuzzOptions *options = self->options;
+    self->state = self->seed ? self->seed : 1;
+
+    self->stub = PDStubNew();
+    PDStubMakeCurrent(self->stub);
+    PDStubSetAssetPath(self->stub, options->assetPath);
+    PDStubSetRasterEnabled(self->stub, options->rasterEnabled);
+    playdate->system->setUpdateCallback(hostUpdate, self);
+
+    for (unsigned int index = 0; index < sizeof(self->text); index++) {
+        self->text[index] = ' ' + randomBelow(self, 95);
+    }
+    self->refreshRate = 30.0f;
+    self->keyboard = keyboardApi.newKeyboard();
+    keyboardApi.setPlaydateUpdateCallback(self->keyboard, hostUpdate, self);
+    if (options->recordingPrefix) {
+        char path[1024];
+        snprintf(path, sizeof(path), "%s%u.pdkr", options->recordingPrefix, self->index);
+        keyboardApi.startRecording(self->keyboard, path);
+    }
+
+    PDFuzzInput previous = {};
+    const unsigned int length = options->historyLength;
+    for (self->framesRun = 0; self->framesRun < options->frameCount; ) {
+        PDFuzzInput *input = &self->history[self->historyIndex];
+        generateInput(self, input, &previous);
+        previous = *input;
+        self->current = input;
+        self->historyIndex = (self->historyIndex + 1) % length;
+
+        PDStubSetTime(self->stub, input->time);
+        PDStubSetButtons(self->stub, input->buttons);
+        PDStubSetCrankChange(self->stub, input->crankChange);
+
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        PDStubRunFrame(self->stub);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        self->framesRun++;
+
+        keepIfSlowest(self, elapsedNanoseconds(&start, &end));
+
+        const unsigned int errorCount = PDStubGetErrorCount(self->stub);
+        if (errorCount > self->errorCount) {
+            if (self->errorCount == 0) {
+                copyHistory(self, &self->firstError, 0);
+            }
+            self->errorCount = errorCount;
+        }
+        char *text;
+        unsigned int textLength;
+        keyboardApi.getText(self->keyboard, &text, &textLength);
+        if (textLength > self->maxTextLength) {
+            self->maxTextLength = textLength;
+        }
+    }
+    self->current = NULL;
+
+    keyboardApi.freeKeyboard(self->keyboard);
+    PDStubFree(self->stub);
+    return NULL;
+}
+
+#pragma mark - Report
+
+static void printHistory(const PDFuzzSlowFrame * _Nonnull slowFrame) {
+    printf("     %10s %10s %8s %10s  %s\n", "frame", "time", "buttons", "crank", "event");
+    for (unsigned int index = 0; index < slowFrame->historyLength; index++) {
+        const PDFuzzInput *input = &slowFrame->history[index];
+        printf("     %10lu %10u %8x %10.2f  %s", input->frame, input->time, input->buttons, input->crankChange, eventNames[input->event]);
+        if (input->event != kFuzzEventNone && input->event != kFuzzEventHide) {
+            printf(" %u", input->eventArgument);
+        }
+        printf("\n");
+    }
+}
+
+static int compareSlowFrames(const void * _Nonnull lhs, const void * _Nonnull rhs) {
+    const unsigned long left = (*(const PDFuzzSlowFrame **) lhs)->nanoseconds;
+    const unsigned long right = (*(const PDFuzzSlowFrame **) rhs)->nanoseconds;
+    return left < right ? 1 : left > right ? -1 : 0;
+}
+
+static void usage(const char * _Nonnull name) {
+    fprintf(stderr, "usage: %s [-j jobs] [-n frames] [-s seed] [-k slowest] [-l history] [-a asset folder] [-R] [-o prefix]\n", name);
+    fprintf(stderr, "Runs independent keyboards on every core with random inputs and reports the throughput, errors and slowest frames.\n");
+    fprintf(stderr, "  -j  number of workers, defaults to the number of cores\n");
+    fprintf(stderr, "  -n  frames run by each worker (default 100000)\n");
+    fprintf(stderr, "  -s  seed of the first worker, worker i uses seed + i (default 1)\n");
+    fprintf(stderr, "  -k  number of slowest frames to report (default 5)\n");
+    fprintf(stderr, "  -l  number of input frames printed up to each slow frame (default 8)\n");
+    fprintf(stderr, "  -a  folder containing CoreLibs, defaults to $PLAYDATE_SDK_PATH\n");
+    fprintf(stderr, "  -R  enable the rasterizer\n");
+    fprintf(stderr, "  -o  record each worker session as <prefix><worker>.pdkr\n");
+}
+
+int main(int argc, char * _Nonnull argv[]) {
+    long jobCount = sysconf(_SC_NPROCESSORS_ONLN);
+    uint64_t seed = 1;
+    PDFuzzOptions options = {
+        .frameCount = 100000,
+        .historyLength = 8,
+        .slowestCount = 5,
+        .assetPath = getenv("PLAYDATE_SDK_PATH"),
+    };
+
+    int option;
+    while ((option = getopt(argc, argv, "j:n:s:k:l:a:Ro:h")) != -1) {
+        switch (option) {
+            case 'j':
+                jobCount = atol(optarg);
+                break;
+            case 'n':
+                options.frameCount = strtoul(optarg, NULL, 10);
+                break;
+            case 's':
+                seed = strtoull(optarg, NULL, 0);
+                break;
+            case 'k':
+                options.slowestCount = (unsigned int) atoi(optarg);
+                break;
+            case 'l':
+                options.historyLength = (unsigned int) atoi(optarg);
+                break;
+            case 'a':
+                options.assetPath = optarg;
+                break;
+            case 'R':
+                options.rasterEnabled = 1;
+                break;
+            case 'o':
+                options.recordingPrefix = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return option == 'h' ? 0 : 1;
+        }
+    }
+    if (jobCount < 1 || options.slowestCount < 1 || options.slowestCount > kMaxSlowestCount
+        || options.historyLength < 1 || options.historyLength > kMaxHistoryLength) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    PDFuzzWorker *workers = calloc(jobCount, sizeof(PDFuzzWorker));
+    pthread_t *threads = calloc(jobCount, sizeof(pthread_t));
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (long index = 0; index < jobCount; index++) {
+        workers[index].index = (unsigned int) index;
+        workers[index].seed = seed + index;
+        workers[index].options = &options;
+        if (pthread_create(&threads[index], NULL, runWorker, &workers[index])) {
+            perror("pthread_create");
+            return 1;
+        }
+    }
+    for (long index = 0; index < jobCount; index++) {
+        pthread_join(threads[index], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    unsigned long frameCount = 0;
+    unsigned int errorCount = 0;
+    unsigned int maxTextLength = 0;
+    unsigned int slowestCount = 0;
+    const PDFuzzSlowFrame **slowest = calloc(jobCount * options.slowestCount, sizeof(PDFuzzSlowFrame *));
+    for (long index = 0; index < jobCount; index++) {
+        PDFuzzWorker *worker = &workers[index];
+        frameCount += worker->framesRun;
+        errorCount += worker->errorCount;
+        if (worker->maxTextLength > maxTextLength) {
+            maxTextLength = worker->maxTextLength;
+        }
+        for (unsigned int slowIndex = 0; slowIndex < worker->slowestCount; slowIndex++) {
+            slowest[slowestCount++] = &worker->slowest[slowIndex];
+        }
+    }
+    qsort(slowest, slowestCount, sizeof(PDFuzzSlowFrame *), compareSlowFrames);
+    if (slowestCount > options.slowestCount) {
+        slowestCount = options.slowestCount;
+    }
+
+    const double seconds = elapsedNanoseconds(&start, &end) / 1e9;
+    printf("workers: %ld, frames: %lu, wall time: %.2f s, %.0f simulated frames/s\n", jobCount, frameCount, seconds, frameCount / seconds);
+    printf("errors: %u, longest text: %u\n", errorCount, maxTextLength);
+    for (long index = 0; index < jobCount; index++) {
+        if (workers[index].errorCount > 0) {
+            printf("  worker %ld (seed %" PRIu64 "): %u errors, first one after:\n", index, workers[index].seed, workers[index].errorCount);
+            printHistory(&workers[index].firstError);
+        }
+    }
+    printf("slowest frames (reproduce with -j 1 -s <seed> -n <frame + 1>):\n");
+    for (unsigned int index = 0; index < slowestCount; index++) {
+        const PDFuzzSlowFrame *slowFrame = slowest[index];
+        const PDFuzzInput *last = &slowFrame->history[slowFrame->historyLength - 1];
+        printf("  #%u %lu ns, worker %u (seed %" PRIu64 "), frame %lu\n", index + 1, slowFrame->nanoseconds, slowFrame->worker, slowFrame->seed, last->frame);
+        printHistory(slowFrame);
+    }
+
+    free(slowest);
+    free(threads);
+    free(workers);
+    return errorCount > 0;
+}
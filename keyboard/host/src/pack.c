@@ -0,0 +1,319 @@
+//
+//  pack.c
+//  pd-keyboard
+//
+//  Created by agent on 17/10/2026.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "pd_stub.h"
+
+// Builds the keyboard atlas read by loadAtlas in src/keyboard.c, the format is described
+// at the top of the Atlas section. Glyphs are drawn by the stub rasterizer with the same
+// drawText calls as the keyboard, so that columns built from the atlas are pixel identical.
+
+static const uint8_t kAtlasMagic[] = {'P', 'D', 'K', 'A'};
+static const uint8_t kAtlasVersion = 1;
+
+typedef enum {
+    kAtlasGlyphs = 1,
+    kAtlasMenuImage = 2,
+    kAtlasSound = 3,
+} PDKeyboardAtlasTag;
+
+/// Every character of the keyboard columns.
+#define kFirstCharacter '!'
+#define kLastCharacter '~'
+
+static const char kFontPath[] = "CoreLibs/assets/keyboard/Roobert-24-Keyboard-Medium";
+
+/// Indexed by PDKeyboardMenuOption.
+static const char * _Nonnull menuImagePaths[] = {
+    "CoreLibs/assets/keyboard/menu-space",
+    "CoreLibs/assets/keyboard/menu-ok",
+    "CoreLibs/assets/keyboard/menu-del",
+    "CoreLibs/assets/keyboard/menu-cancel",
+};
+#define kMenuImageCount 4
+
+/// Indexed by PDKeyboardSound.
+static const char * _Nonnull soundPaths[] = {
+    "CoreLibs/assets/sfx/selection.wav",
+    "CoreLibs/assets/sfx/selection-reverse.wav",
+    "CoreLibs/assets/sfx/click.wav",
+    "CoreLibs/assets/sfx/denial.wav",
+    "CoreLibs/assets/sfx/key.wav",
+};
+#define kSoundCount 5
+
+typedef struct {
+    uint8_t * _Nullable bytes;
+    size_t count;
+    size_t capacity;
+    /// Offset of the length of the current section.
+    size_t sectionStart;
+} PDPackBuffer;
+
+static void bufferWrite(PDPackBuffer * _Nonnull self, const void * _Nonnull bytes, size_t count) {
+    if (self->count + count > self->capacity) {
+        self->capacity = (self->count + count) * 2;
+        self->bytes = realloc(self->bytes, self->capacity);
+    }
+    memcpy(self->bytes + self->count, bytes, count);
+    self->count += count;
+}
+
+static void bufferWriteUInt(PDPackBuffer * _Nonnull self, uint32_t value, unsigned int size) {
+    uint8_t bytes[4];
+    for (unsigned int index = 0; index < size; index++) {
+        bytes[index] = (value >> (index * 8)) & 0xFF;
+    }
+    bufferWrite(self, bytes, size);
+}
+
+static void bufferBeginSection(PDPackBuffer * _Nonnull self, PDKeyboardAtlasTag tag) {
+    bufferWriteUInt(self, tag, 1);
+    self->sectionStart = self->count;
+    bufferWriteUInt(self, 0, 4);
+}
+
+static void bufferEndSection(PDPackBuffer * _Nonnull self) {
+    const uint32_t length = (uint32_t) (self->count - self->sectionStart - 4);
+    for (unsigned int index = 0; index < 4; index++) {
+        self->bytes[self->sectionStart + index] = (length >> (index * 8)) & 0xFF;
+    }
+}
+
+static void bufferWriteImage(PDPackBuffer * _Nonnull self, LCDBitmap * _Nonnull image) {
+    int width, height, rowbytes;
+    uint8_t *mask, *data;
+    playdate->graphics->getBitmapData(image, &width, &height, &rowbytes, &mask, &data);
+    bufferWriteUInt(self, width, 2);
+    bufferWriteUInt(self, height, 2);
+    bufferWriteUInt(self, mask != NULL, 1);
+    const int packedRowbytes = (width + 7) / 8;
+    for (int y = 0; y < height; y++) {
+        bufferWrite(self, data + y * rowbytes, packedRowbytes);
+    }
+    for (int y = 0; mask && y < height; y++) {
+        bufferWrite(self, mask + y * rowbytes, packedRowbytes);
+    }
+}
+
+static int writeGlyphs(PDPackBuffer * _Nonnull buffer) {
+    const char *error = NULL;
+    LCDFont *font = playdate->graphics->loadFont(kFontPath, &error);
+    if (error) {
+        fprintf(stderr, "Unable to load font %s: %s\n", kFontPath, error);
+        return 0;
+    }
+    const int fontHeight = playdate->graphics->getFontHeight(font);
+    int advances[kLastCharacter + 1];
+    int cellWidth = 1;
+    for (char character = kFirstCharacter; character <= kLastCharacter; character++) {
+        advances[(int) character] = playdate->graphics->getTextWidth(font, &character, 1, kASCIIEncoding, 0);
+        cellWidth = advances[(int) character] > cellWidth ? advances[(int) character] : cellWidth;
+    }
+
+    // Every glyph is drawn in a cell as wide as the widest glyph: the keyboard never draws
+    // a glyph in a wider area.
+    bufferBeginSection(buffer, kAtlasGlyphs);
+    bufferWriteUInt(buffer, fontHeight, 1);
+    bufferWriteUInt(buffer, kFirstCharacter, 1);
+    bufferWriteUInt(buffer, kLastCharacter - kFirstCharacter + 1, 1);
+    for (char character = kFirstCharacter; character <= kLastCharacter; character++) {
+        LCDBitmap *cell = playdate->graphics->newBitmap(cellWidth, fontHeight, kColorClear);
+        playdate->graphics->pushContext(cell);
+        playdate->graphics->setFont(font);
+        playdate->graphics->setDrawMode(kDrawModeCopy);
+        playdate->graphics->drawText(&character, 1, kASCIIEncoding, 0, 0);
+        playdate->graphics->popContext();
+        bufferWriteUInt(buffer, advances[(int) character], 1);
+        bufferWriteImage(buffer, cell);
+        playdate->graphics->freeBitmap(cell);
+    }
+    bufferEndSection(buffer);
+    playdate->system->realloc(font, 0);
+    return 1;
+}
+
+static int writeMenuImages(PDPackBuffer * _Nonnull buffer) {
+    for (unsigned int index = 0; index < kMenuImageCount; index++) {
+        const char *error = NULL;
+        LCDBitmap *image = playdate->graphics->loadBitmap(menuImagePaths[index], &error);
+        if (error) {
+            fprintf(stderr, "Unable to load image %s: %s\n", menuImagePaths[index], error);
+            return 0;
+        }
+        bufferBeginSection(buffer, kAtlasMenuImage);
+        bufferWriteUInt(buffer, index, 1);
+        bufferWriteImage(buffer, image);
+        bufferEndSection(buffer);
+        playdate->graphics->freeBitmap(image);
+    }
+    return 1;
+}
+
+static uint32_t readUInt(const uint8_t * _Nonnull bytes, unsigned int size) {
+    uint32_t value = 0;
+    for (unsigned int index = 0; index < size; index++) {
+        value |= (uint32_t) bytes[index] << (index * 8);
+    }
+    return value;
+}
+
+/// @brief Reads the PCM data of a WAV file into <em>buffer</em> as a kAtlasSound section.
+static int writeSound(PDPackBuffer * _Nonnull buffer, unsigned int sound, const char * _Nonnull assetPath) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s", assetPath, soundPaths[sound]);
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "Unable to open %s\n", path);
+        return 0;
+    }
+    fseek(file, 0, SEEK_END);
+    const long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t *bytes = malloc(size > 0 ? size : 1);
+    const int isRead = size > 12 && fread(bytes, 1, size, file) == (size_t) size;
+    fclose(file);
+    if (!isRead || memcmp(bytes, "RIFF", 4) != 0 || memcmp(bytes + 8, "WAVE", 4) != 0) {
+        fprintf(stderr, "%s is not a WAV file\n", path);
+        free(bytes);
+        return 0;
+    }
+
+    int format = -1;
+    uint32_t sampleRate = 0;
+    const uint8_t *data = NULL;
+    uint32_t dataCount = 0;
+    for (long offset = 12; offset + 8 <= size; ) {
+        const uint32_t chunkSize = readUInt(bytes + offset + 4, 4);
+        const uint8_t *chunk = bytes + offset + 8;
+        if (chunkSize > size - offset - 8) {
+            break;
+        }
+        if (memcmp(bytes + offset, "fmt ", 4) == 0 && chunkSize >= 16) {
+            const uint32_t audioFormat = readUInt(chunk, 2);
+            const uint32_t channels = readUInt(chunk + 2, 2);
+            const uint32_t bitsPerSample = readUInt(chunk + 14, 2);
+            sampleRate = readUInt(chunk + 4, 4);
+            if (audioFormat == 1 && (channels == 1 || channels == 2) && (bitsPerSample == 8 || bitsPerSample == 16)) {
+                format = (bitsPerSample == 16 ? kSound16bitMono : kSound8bitMono) + (channels == 2);
+            }
+        } else if (memcmp(bytes + offset, "data", 4) == 0) {
+            data = chunk;
+            dataCount = chunkSize;
+        }
+        offset += 8 + chunkSize + (chunkSize & 1);
+    }
+    if (format < 0 || data == NULL) {
+        fprintf(stderr, "%s: only 8 or 16 bits PCM WAV files are supported\n", path);
+        free(bytes);
+        return 0;
+    }
+    bufferBeginSection(buffer, kAtlasSound);
+    bufferWriteUInt(buffer, sound, 1);
+    bufferWriteUInt(buffer, format, 1);
+    bufferWriteUInt(buffer, sampleRate, 4);
+    bufferWrite(buffer, data, dataCount);
+    bufferEndSection(buffer);
+    free(bytes);
+    return 1;
+}
+
+/// @brief Prints the sections of the atlas at <em>path</em>.
+static int listAtlas(const char * _Nonnull path) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "Unable to open %s\n", path);
+        return 0;
+    }
+    uint8_t header[5];
+    if (fread(header, 1, sizeof(header), file) != sizeof(header) || memcmp(header, kAtlasMagic, sizeof(kAtlasMagic)) != 0) {
+        fprintf(stderr, "%s is not a keyboard atlas\n", path);
+        fclose(file);
+        return 0;
+    }
+    printf("%s: version %u\n", path, header[4]);
+    static const char * _Nonnull tagNames[] = {"unknown", "glyphs", "menu image", "sound"};
+    uint8_t sectionHeader[5];
+    while (fread(sectionHeader, 1, sizeof(sectionHeader), file) == sizeof(sectionHeader)) {
+        const uint32_t length = readUInt(sectionHeader + 1, 4);
+        const unsigned int tag = sectionHeader[0] <= kAtlasSound ? sectionHeader[0] : 0;
+        // Menu images and sounds start with their index.
+        const int index = tag == kAtlasMenuImage || tag == kAtlasSound ? fgetc(file) : -1;
+        printf("  %-10s %8u bytes", tagNames[tag], length);
+        printf(index >= 0 ? ", index %d\n" : "\n", index);
+        fseek(file, length - (index >= 0), SEEK_CUR);
+    }
+    fclose(file);
+    return 1;
+}
+
+static void usage(const char * _Nonnull name) {
+    fprintf(stderr, "usage: %s [-a asset folder] [-s] [-o atlas] | -l atlas\n", name);
+    fprintf(stderr, "Packs the keyboard font and menu images into a single file, copy it to Source/CoreLibs/assets/keyboard/keyboard.pdka.\n");
+    fprintf(stderr, "  -a  folder containing CoreLibs, defaults to $PLAYDATE_SDK_PATH\n");
+    fprintf(stderr, "  -s  also pack the sfx samples, they must be 8 or 16 bits PCM WAV files\n");
+    fprintf(stderr, "  -o  output file, defaults to keyboard.pdka\n");
+    fprintf(stderr, "  -l  list the sections of the given atlas\n");
+}
+
+int main(int argc, char * _Nonnull argv[]) {
+    const char *assetPath = getenv("PLAYDATE_SDK_PATH");
+    const char *outputPath = "keyboard.pdka";
+    int packSounds = 0;
+
+    int option;
+    while ((option = getopt(argc, argv, "a:so:l:h")) != -1) {
+        switch (option) {
+            case 'a':
+                assetPath = optarg;
+                break;
+            case 's':
+                packSounds = 1;
+                break;
+            case 'o':
+                outputPath = optarg;
+                break;
+            case 'l':
+                return listAtlas(optarg) ? 0 : 1;
+            default:
+                usage(argv[0]);
+                return option == 'h' ? 0 : 2;
+        }
+    }
+    if (assetPath == NULL) {
+        fprintf(stderr, "No asset folder, set PLAYDATE_SDK_PATH or use -a\n");
+        return 2;
+    }
+
+    PDStub *stub = PDStubNew();
+    PDStubMakeCurrent(stub);
+    PDStubSetAssetPath(stub, assetPath);
+
+    PDPackBuffer buffer = {};
+    bufferWrite(&buffer, kAtlasMagic, sizeof(kAtlasMagic));
+    bufferWriteUInt(&buffer, kAtlasVersion, 1);
+    int isPacked = writeGlyphs(&buffer) && writeMenuImages(&buffer);
+    for (unsigned int sound = 0; isPacked && packSounds && sound < kSoundCount; sound++) {
+        isPacked = writeSound(&buffer, sound, assetPath);
+    }
+
+    FILE *output = isPacked ? fopen(outputPath, "wb") : NULL;
+    if (output) {
+        isPacked = fwrite(buffer.bytes, 1, buffer.count, output) == buffer.count;
+        fclose(output);
+        printf("%s: %zu bytes\n", outputPath, buffer.count);
+    } else if (isPacked) {
+        fprintf(stderr, "Unable to write %s\n", outputPath);
+        isPacked = 0;
+    }
+    free(buffer.bytes);
+    PDStubFree(stub);
+    return isPacked ? 0 : 1;
+}
@@ -0,0 +1,389 @@
+//
+//  pd_raster.c
+//  pd-keyboard
+//
+//  Created by agent on 16/10/2026.
+//
+
+#include "pd_raster.h"
+
+#pragma mark - Surface
+
+void PDRasterSurfaceInit(PDRasterSurface * _Nonnull self, int width, int height, LCDColor color) {
+    const int rowbytes = ((width + 31) / 32) * 4;
+    *self = (PDRasterSurface) {
+        .data = calloc(rowbytes * height > 0 ? rowbytes * height : 1, 1),
+        .width = width,
+        .height = height,
+        .rowbytes = rowbytes,
+    };
+    if (color == kColorWhite) {
+        memset(self->data, 0xFF, rowbytes * height);
+    } else if (color == kColorClear) {
+        self->mask = calloc(rowbytes * height > 0 ? rowbytes * height : 1, 1);
+    }
+}
+
+void PDRasterSurfaceCopy(PDRasterSurface * _Nonnull self, const PDRasterSurface * _Nonnull source) {
+    const size_t size = source->rowbytes * source->height;
+    *self = *source;
+    self->data = malloc(size > 0 ? size : 1);
+    memcpy(self->data, source->data, size);
+    if (source->mask) {
+        self->mask = malloc(size > 0 ? size : 1);
+        memcpy(self->mask, source->mask, size);
+    }
+}
+
+void PDRasterSurfaceDeinit(PDRasterSurface * _Nonnull self) {
+    free(self->data);
+    free(self->mask);
+    self->data = NULL;
+    self->mask = NULL;
+}
+
+uint64_t PDRasterSurfaceHash(const PDRasterSurface * _Nonnull self) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    const int fullBytes = self->width / 8;
+    const int remainingBits = self->width % 8;
+    const uint8_t lastByteMask = (uint8_t) (0xFF << (8 - remainingBits));
+    for (int plane = 0; plane < 2; plane++) {
+        const uint8_t *bytes = plane == 0 ? self->data : self->mask;
+        if (bytes == NULL) {
+            continue;
+        }
+        for (int y = 0; y < self->height; y++) {
+            const uint8_t *row = bytes + y * self->rowbytes;
+            for (int x = 0; x < fullBytes; x++) {
+                hash = (hash ^ row[x]) * 0x100000001b3ULL;
+            }
+            if (remainingBits) {
+                hash = (hash ^ (row[fullBytes] & lastByteMask)) * 0x100000001b3ULL;
+            }
+        }
+    }
+    return hash;
+}
+
+int PDRasterSurfaceWritePBM(const PDRasterSurface * _Nonnull self, FILE * _Nonnull output) {
+    fprintf(output, "P4\n%d %d\n", self->width, self->height);
+    const int bytesPerRow = (self->width + 7) / 8;
+    uint8_t row[bytesPerRow];
+    for (int y = 0; y < self->height; y++) {
+        // PBM uses 1 for black.
+        for (int x = 0; x < bytesPerRow; x++) {
+            row[x] = ~self->data[y * self->rowbytes + x];
+        }
+        if (fwrite(row, 1, bytesPerRow, output) != bytesPerRow) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+#pragma mark - Pixels
+
+static inline void writePixel(PDRasterSurface * _Nonnull target, int x, int y, int white) {
+    const int index = y * target->rowbytes + (x >> 3);
+    const uint8_t bit = 0x80 >> (x & 7);
+    if (white) {
+        target->data[index] |= bit;
+    } else {
+        target->data[index] &= ~bit;
+    }
+    if (target->mask) {
+        target->mask[index] |= bit;
+    }
+}
+
+/// @brief Plot a pixel of the given color. Returns 1 if the pixel was written.
+static inline int plot(PDRasterSurface * _Nonnull target, int x, int y, LCDColor color) {
+    switch (color) {
+        case kColorBlack:
+            writePixel(target, x, y, 0);
+            return 1;
+        case kColorWhite:
+            writePixel(target, x, y, 1);
+            return 1;
+        case kColorClear:
+            return 0;
+        case kColorXOR:
+            writePixel(target, x, y, !PDRasterSurfaceGetPixel(target, x, y));
+            return 1;
+        default: {
+            // Pattern: 8 rows of pixels followed by 8 rows of mask.
+            const uint8_t *pattern = (const uint8_t *) color;
+            const uint8_t bit = 0x80 >> (x & 7);
+            if (!(pattern[8 + (y & 7)] & bit)) {
+                return 0;
+            }
+            writePixel(target, x, y, (pattern[y & 7] & bit) != 0);
+            return 1;
+        }
+    }
+}
+
+static int intersect(PDRasterRect * _Nonnull rect, PDRasterRect clip) {
+    const int left = rect->x > clip.x ? rect->x : clip.x;
+    const int top = rect->y > clip.y ? rect->y : clip.y;
+    const int rectRight = rect->x + rect->width;
+    const int clipRight = clip.x + clip.width;
+    const int rectBottom = rect->y + rect->height;
+    const int clipBottom = clip.y + clip.height;
+    const int right = rectRight < clipRight ? rectRight : clipRight;
+    const int bottom = rectBottom < clipBottom ? rectBottom : clipBottom;
+    *rect = (PDRasterRect) {
+        .x = left,
+        .y = top,
+        .width = right - left,
+        .height = bottom - top,
+    };
+    return rect->width > 0 && rect->height > 0;
+}
+
+static inline int isInClip(const PDRasterContext * _Nonnull context, int x, int y) {
+    const PDRasterRect clip = context->clip;
+    return x >= clip.x && y >= clip.y && x < clip.x + clip.width && y < clip.y + clip.height;
+}
+
+#pragma mark - Context
+
+static PDRasterRect surfaceBounds(const PDRasterSurface * _Nonnull surface) {
+    return (PDRasterRect) {
+        .width = surface->width,
+        .height = surface->height,
+    };
+}
+
+void PDRasterInit(PDRaster * _Nonnull self) {
+    *self = (PDRaster) {};
+    // Rows are padded to 32 bits, 400 columns gives the LCD_ROWSIZE of the device.
+    PDRasterSurfaceInit(&self->frame, LCD_COLUMNS, LCD_ROWS, kColorWhite);
+    self->contexts[0] = (PDRasterContext) {
+        .target = &self->frame,
+        .drawMode = kDrawModeCopy,
+        .clip = surfaceBounds(&self->frame),
+    };
+}
+
+void PDRasterDeinit(PDRaster * _Nonnull self) {
+    PDRasterSurfaceDeinit(&self->frame);
+}
+
+void PDRasterPushContext(PDRaster * _Nonnull self, PDRasterSurface * _Nullable target) {
+    if (self->contextIndex + 1 >= kPDRasterContextStackSize) {
+        return;
+    }
+    const PDRasterContext previous = self->contexts[self->contextIndex];
+    PDRasterSurface *newTarget = target ? target : &self->frame;
+    self->contexts[++self->contextIndex] = (PDRasterContext) {
+        .target = newTarget,
+        .drawMode = previous.drawMode,
+        .clip = surfaceBounds(newTarget),
+    };
+}
+
+void PDRasterPopContext(PDRaster * _Nonnull self) {
+    if (self->contextIndex > 0) {
+        self->contextIndex--;
+    }
+}
+
+void PDRasterSetClipRect(PDRaster * _Nonnull self, int x, int y, int width, int height) {
+    PDRasterContext *context = PDRasterGetContext(self);
+    PDRasterRect clip = {
+        .x = x + context->offsetX,
+        .y = y + context->offsetY,
+        .width = width,
+        .height = height,
+    };
+    if (!intersect(&clip, surfaceBounds(context->target))) {
+        clip = (PDRasterRect) {};
+    }
+    context->clip = clip;
+}
+
+void PDRasterClearClipRect(PDRaster * _Nonnull self) {
+    PDRasterContext *context = PDRasterGetContext(self);
+    context->clip = surfaceBounds(context->target);
+}
+
+#pragma mark - Primitives
+
+void PDRasterClear(PDRaster * _Nonnull self, LCDColor color) {
+    PDRasterSurface *target = PDRasterGetContext(self)->target;
+    unsigned long written = 0;
+    for (int y = 0; y < target->height; y++) {
+        for (int x = 0; x < target->width; x++) {
+            written += plot(target, x, y, color);
+        }
+    }
+    self->pixelsWritten += written;
+}
+
+void PDRasterFillRect(PDRaster * _Nonnull self, int x, int y, int width, int height, LCDColor color) {
+    PDRasterContext *context = PDRasterGetContext(self);
+    if (width < 0) {
+        x += width;
+        width = -width;
+    }
+    if (height < 0) {
+        y += height;
+        height = -height;
+    }
+    PDRasterRect rect = {
+        .x = x + context->offsetX,
+        .y = y + context->offsetY,
+        .width = width,
+        .height = height,
+    };
+    if (!intersect(&rect, context->clip)) {
+        return;
+    }
+    PDRasterSurface *target = context->target;
+    unsigned long written = 0;
+    for (int row = rect.y; row < rect.y + rect.height; row++) {
+        for (int column = rect.x; column < rect.x + rect.width; column++) {
+            written += plot(target, column, row, color);
+        }
+    }
+    self->pixelsWritten += written;
+}
+
+void PDRasterDrawRect(PDRaster * _Nonnull self, int x, int y, int width, int height, LCDColor color) {
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+    PDRasterFillRect(self, x, y, width, 1, color);
+    if (height > 1) {
+        PDRasterFillRect(self, x, y + height - 1, width, 1, color);
+    }
+    if (height > 2) {
+        PDRasterFillRect(self, x, y + 1, 1, height - 2, color);
+        if (width > 1) {
+            PDRasterFillRect(self, x + width - 1, y + 1, 1, height - 2, color);
+        }
+    }
+}
+
+void PDRasterDrawLine(PDRaster * _Nonnull self, int x1, int y1, int x2, int y2, int width, LCDColor color) {
+    PDRasterContext *context = PDRasterGetContext(self);
+    PDRasterSurface *target = context->target;
+    x1 += context->offsetX;
+    x2 += context->offsetX;
+    y1 += context->offsetY;
+    y2 += context->offsetY;
+    if (width < 1) {
+        width = 1;
+    }
+
+    const int dx = abs(x2 - x1);
+    const int dy = -abs(y2 - y1);
+    const int stepX = x1 < x2 ? 1 : -1;
+    const int stepY = y1 < y2 ? 1 : -1;
+    // Thick lines are drawn as spans perpendicular to the major axis.
+    const int horizontal = dx >= -dy;
+    const int spanStart = -(width - 1) / 2;
+
+    unsigned long written = 0;
+    int error = dx + dy;
+    int x = x1;
+    int y = y1;
+    while (1) {
+        for (int span = spanStart; span < spanStart + width; span++) {
+            const int px = horizontal ? x : x + span;
+            const int py = horizontal ? y + span : y;
+            if (isInClip(context, px, py)) {
+                written += plot(target, px, py, color);
+            }
+        }
+        if (x == x2 && y == y2) {
+            break;
+        }
+        const int doubleError = 2 * error;
+        if (doubleError >= dy) {
+            error += dy;
+            x += stepX;
+        }
+        if (doubleError <= dx) {
+            error += dx;
+            y += stepY;
+        }
+    }
+    self->pixelsWritten += written;
+}
+
+void PDRasterDrawSurface(PDRaster * _Nonnull self, const PDRasterSurface * _Nonnull source, int x, int y, LCDBitmapFlip flip) {
+    PDRasterContext *context = PDRasterGetContext(self);
+    PDRasterRect rect = {
+        .x = x + context->offsetX,
+        .y = y + context->offsetY,
+        .width = source->width,
+        .height = source->height,
+    };
+    const int originX = rect.x;
+    const int originY = rect.y;
+    if (!intersect(&rect, context->clip)) {
+        return;
+    }
+    const int flipX = flip == kBitmapFlippedX || flip == kBitmapFlippedXY;
+    const int flipY = flip == kBitmapFlippedY || flip == kBitmapFlippedXY;
+    const LCDBitmapDrawMode drawMode = context->drawMode;
+    PDRasterSurface *target = context->target;
+
+    unsigned long written = 0;
+    for (int row = rect.y; row < rect.y + rect.height; row++) {
+        const int sourceY = flipY ? source->height - 1 - (row - originY) : row - originY;
+        for (int column = rect.x; column < rect.x + rect.width; column++) {
+            const int sourceX = flipX ? source->width - 1 - (column - originX) : column - originX;
+            if (!PDRasterSurfaceIsOpaque(source, sourceX, sourceY)) {
+                continue;
+            }
+            const int white = PDRasterSurfaceGetPixel(source, sourceX, sourceY);
+            switch (drawMode) {
+                case kDrawModeCopy:
+                    writePixel(target, column, row, white);
+                    break;
+                case kDrawModeWhiteTransparent:
+                    if (white) {
+                        continue;
+                    }
+                    writePixel(target, column, row, 0);
+                    break;
+                case kDrawModeBlackTransparent:
+                    if (!white) {
+                        continue;
+                    }
+                    writePixel(target, column, row, 1);
+                    break;
+                case kDrawModeFillWhite:
+                    writePixel(target, column, row, 1);
+                    break;
+                case kDrawModeFillBlack:
+                    writePixel(target, column, row, 0);
+                    break;
+                case kDrawModeXOR:
+                    // White pixels invert the destination.
+                    if (!white) {
+                        continue;
+                    }
+                    writePixel(target, column, row, !PDRasterSurfaceGetPixel(target, column, row));
+                    break;
+                case kDrawModeNXOR:
+                    // Black pixels invert the destination.
+                    if (white) {
+                        continue;
+                    }
+                    writePixel(target, column, row, !PDRasterSurfaceGetPixel(target, column, row));
+                    break;
+                case kDrawModeInverted:
+                    writePixel(target, column, row, !white);
+                    break;
+                default:
+                    continue;
+            }
+            written++;
+        }
+    }
+    self->pixelsWritten += written;
+}
@@ -0,0 +1,101 @@
+//
+//  pd_raster.h
+//  pd-keyboard
+//
+//  Created by agent on 16/10/2026.
+//
+
+#ifndef pd_raster_h
+#define pd_raster_h
+
+#include <stdio.h>
+
+#include "pd_api.h"
+
+/**
+ * 1-bit surface using the same layout as the Playdate frame buffer and bitmaps:
+ * rows are <code>rowbytes</code> long, the most significant bit is the left
+ * most pixel and a set bit is white. A set bit in <code>mask</code> is opaque.
+ */
+typedef struct {
+    uint8_t * _Nullable data;
+    uint8_t * _Nullable mask;
+    int width;
+    int height;
+    int rowbytes;
+} PDRasterSurface;
+
+typedef struct {
+    int x;
+    int y;
+    int width;
+    int height;
+} PDRasterRect;
+
+typedef struct {
+    PDRasterSurface * _Nonnull target;
+    LCDBitmapDrawMode drawMode;
+    int offsetX;
+    int offsetY;
+    PDRasterRect clip;
+} PDRasterContext;
+
+#define kPDRasterContextStackSize 16
+
+typedef struct {
+    PDRasterSurface frame;
+    PDRasterContext contexts[kPDRasterContextStackSize];
+    int contextIndex;
+    unsigned long pixelsWritten;
+} PDRaster;
+
+void PDRasterSurfaceInit(PDRasterSurface * _Nonnull self, int width, int height, LCDColor color);
+void PDRasterSurfaceCopy(PDRasterSurface * _Nonnull self, const PDRasterSurface * _Nonnull source);
+void PDRasterSurfaceDeinit(PDRasterSurface * _Nonnull self);
+
+static inline int PDRasterSurfaceGetPixel(const PDRasterSurface * _Nonnull self, int x, int y) {
+    return (self->data[y * self->rowbytes + (x >> 3)] >> (7 - (x & 7))) & 1;
+}
+
+static inline int PDRasterSurfaceIsOpaque(const PDRasterSurface * _Nonnull self, int x, int y) {
+    return self->mask == NULL || ((self->mask[y * self->rowbytes + (x >> 3)] >> (7 - (x & 7))) & 1);
+}
+
+/**
+ * Returns a FNV-1a hash of the visible pixels (and mask if any) of the surface.
+ */
+uint64_t PDRasterSurfaceHash(const PDRasterSurface * _Nonnull self);
+
+/**
+ * Writes the surface as a binary PBM image. Returns 0 on success.
+ */
+int PDRasterSurfaceWritePBM(const PDRasterSurface * _Nonnull self, FILE * _Nonnull output);
+
+void PDRasterInit(PDRaster * _Nonnull self);
+void PDRasterDeinit(PDRaster * _Nonnull self);
+
+static inline PDRasterContext * _Nonnull PDRasterGetContext(PDRaster * _Nonnull self) {
+    return &self->contexts[self->contextIndex];
+}
+
+/**
+ * Pushes a new context drawing into <em>target</em>, or into the frame buffer
+ * if <em>target</em> is NULL. Draw mode is kept, offset and clip are reset.
+ */
+void PDRasterPushContext(PDRaster * _Nonnull self, PDRasterSurface * _Nullable target);
+void PDRasterPopContext(PDRaster * _Nonnull self);
+
+void PDRasterSetClipRect(PDRaster * _Nonnull self, int x, int y, int width, int height);
+void PDRasterClearClipRect(PDRaster * _Nonnull self);
+
+void PDRasterClear(PDRaster * _Nonnull self, LCDColor color);
+void PDRasterFillRect(PDRaster * _Nonnull self, int x, int y, int width, int height, LCDColor color);
+void PDRasterDrawRect(PDRaster * _Nonnull self, int x, int y, int width, int height, LCDColor color);
+void PDRasterDrawLine(PDRaster * _Nonnull self, int x1, int y1, int x2, int y2, int width, LCDColor color);
+
+/**
+ * Draws <em>source</em> at the given location using the current draw mode.
+ */
+void PDRasterDrawSurface(PDRaster * _Nonnull self, const PDRasterSurface * _Nonnull source, int x, int y, LCDBitmapFlip flip);
+
+#endif /* pd_raster_h */
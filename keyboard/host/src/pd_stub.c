@@ -0,0 +1,1312 @@
+//
+//  pd_stub.c
+//  pd-keyboard
+//
+//  Created by agent on 16/10/2026.
+//
+
+#include "pd_stub.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <stdarg.h>
+#include <time.h>
+
+#if PDSTUB_PNG
+#include <png.h>
+#endif
+
+#include "pd_raster.h"
+
+PDKEYBOARD_THREAD_LOCAL PlaydateAPI * _Nullable playdate;
+
+struct LCDBitmap {
+    PDRasterSurface surface;
+};
+
+typedef struct {
+    uint32_t character;
+    int advance;
+    LCDBitmap * _Nullable bitmap;
+} PDStubGlyph;
+
+struct LCDFont {
+    PDStubGlyph * _Nullable glyphs;
+    int glyphCount;
+    int glyphCapacity;
+    int asciiIndexes[128];
+    int tracking;
+    uint8_t height;
+    /// Next font loaded by the same stub.
+    LCDFont * _Nullable next;
+};
+
+struct AudioSample {
+    char unused;
+};
+
+struct SamplePlayer {
+    AudioSample * _Nullable sample;
+};
+
+struct PDSynth {
+    SoundWaveform waveform;
+};
+
+#define kPDStubButtonEventCapacity 64
+
+typedef struct {
+    PDButtons button;
+    int down;
+    unsigned int when;
+} PDStubButtonEvent;
+
+typedef struct {
+    LCDFont * _Nullable font;
+    int textTracking;
+    int textLeading;
+} PDStubTextState;
+
+typedef struct pdstub {
+    PlaydateAPI api;
+
+    unsigned int time;
+    PDButtons buttons;
+    PDButtons previousButtons;
+    PDButtons pushed;
+    PDButtons released;
+    int buttonStateForced;
+    PDButtons forcedPushed;
+    PDButtons forcedReleased;
+    float crankChange;
+
+    PDButtonCallbackFunction * _Nullable buttonCallback;
+    void * _Nullable buttonCallbackUserdata;
+    int buttonCallbackQueueSize;
+    PDStubButtonEvent buttonEvents[kPDStubButtonEventCapacity];
+    unsigned int buttonEventCount;
+
+    char * _Nullable assetPath;
+    int rasterEnabled;
+    PDRaster raster;
+    LCDFont * _Nullable font;
+    /// Fonts returned by loadFont, freed with realloc(font, 0) like on device.
+    LCDFont * _Nullable loadedFonts;
+    int textTracking;
+    int textLeading;
+    /// Text state saved by pushContext and restored by popContext, like on device.
+    PDStubTextState textStates[kPDRasterContextStackSize];
+    unsigned int textStateCount;
+
+    struct timespec elapsedTimeStart;
+
+    PDCallbackFunction * _Nullable update;
+    void * _Nullable updateUserdata;
+
+    unsigned int frame;
+    unsigned int callCounts[kPDStubCallCount];
+    unsigned long totalCallCounts[kPDStubCallCount];
+    unsigned int errorCount;
+    unsigned int allocationCount;
+
+    int traceEnabled;
+    PDStubTraceEntry * _Nullable trace;
+    unsigned int traceCount;
+    unsigned int traceCapacity;
+} PDStub;
+
+static PDKEYBOARD_THREAD_LOCAL PDStub * _Nullable current;
+
+static const struct {
+    const char * _Nonnull name;
+    int argumentCount;
+} callInfos[kPDStubCallCount] = {
+    [kPDStubCallRealloc] = {"system->realloc", 1},
+    [kPDStubCallError] = {"system->error", 0},
+    [kPDStubCallLogToConsole] = {"system->logToConsole", 0},
+    [kPDStubCallGetCurrentTimeMilliseconds] = {"system->getCurrentTimeMilliseconds", 0},
+    [kPDStubCallSetUpdateCallback] = {"system->setUpdateCallback", 0},
+    [kPDStubCallSetButtonCallback] = {"system->setButtonCallback", 1},
+    [kPDStubCallGetButtonState] = {"system->getButtonState", 3},
+    [kPDStubCallGetCrankChange] = {"system->getCrankChange", 0},
+    [kPDStubCallGetElapsedTime] = {"system->getElapsedTime", 0},
+    [kPDStubCallResetElapsedTime] = {"system->resetElapsedTime", 0},
+
+    [kPDStubCallClear] = {"graphics->clear", 1},
+    [kPDStubCallSetDrawMode] = {"graphics->setDrawMode", 1},
+    [kPDStubCallSetDrawOffset] = {"graphics->setDrawOffset", 2},
+    [kPDStubCallSetClipRect] = {"graphics->setClipRect", 4},
+    [kPDStubCallClearClipRect] = {"graphics->clearClipRect", 0},
+    [kPDStubCallSetFont] = {"graphics->setFont", 0},
+    [kPDStubCallSetTextTracking] = {"graphics->setTextTracking", 1},
+    [kPDStubCallGetTextTracking] = {"graphics->getTextTracking", 0},
+    [kPDStubCallSetTextLeading] = {"graphics->setTextLeading", 1},
+    [kPDStubCallPushContext] = {"graphics->pushContext", 1},
+    [kPDStubCallPopContext] = {"graphics->popContext", 0},
+    [kPDStubCallDrawBitmap] = {"graphics->drawBitmap", 5},
+    [kPDStubCallDrawLine] = {"graphics->drawLine", 6},
+    [kPDStubCallDrawRect] = {"graphics->drawRect", 5},
+    [kPDStubCallFillRect] = {"graphics->fillRect", 5},
+    [kPDStubCallDrawText] = {"graphics->drawText", 5},
+    [kPDStubCallNewBitmap] = {"graphics->newBitmap", 3},
+    [kPDStubCallLoadBitmap] = {"graphics->loadBitmap", 0},
+    [kPDStubCallCopyBitmap] = {"graphics->copyBitmap", 0},
+    [kPDStubCallClearBitmap] = {"graphics->clearBitmap", 1},
+    [kPDStubCallFreeBitmap] = {"graphics->freeBitmap", 0},
+    [kPDStubCallGetBitmapData] = {"graphics->getBitmapData", 2},
+    [kPDStubCallLoadFont] = {"graphics->loadFont", 0},
+    [kPDStubCallGetFontHeight] = {"graphics->getFontHeight", 1},
+    [kPDStubCallGetTextWidth] = {"graphics->getTextWidth", 2},
+    [kPDStubCallGetFrame] = {"graphics->getFrame", 0},
+    [kPDStubCallMarkUpdatedRows] = {"graphics->markUpdatedRows", 2},
+    [kPDStubCallDisplay] = {"graphics->display", 0},
+
+    [kPDStubCallSetRefreshRate] = {"display->setRefreshRate", 1},
+
+    [kPDStubCallSampleLoad] = {"sound->sample->load", 0},
+    [kPDStubCallSampleNewFromData] = {"sound->sample->newSampleFromData", 4},
+    [kPDStubCallSampleFree] = {"sound->sample->freeSample", 0},
+    [kPDStubCallSamplePlayerNew] = {"sound->sampleplayer->newPlayer", 0},
+    [kPDStubCallSamplePlayerFree] = {"sound->sampleplayer->freePlayer", 0},
+    [kPDStubCallSamplePlayerSetSample] = {"sound->sampleplayer->setSample", 0},
+    [kPDStubCallSamplePlayerPlay] = {"sound->sampleplayer->play", 2},
+    [kPDStubCallSynthNew] = {"sound->synth->newSynth", 0},
+    [kPDStubCallSynthFree] = {"sound->synth->freeSynth", 0},
+    [kPDStubCallSynthSetWaveform] = {"sound->synth->setWaveform", 1},
+    [kPDStubCallSynthSetEnvelope] = {"sound->synth->set(Attack|Decay|Release)Time/setSustainLevel", 1},
+    [kPDStubCallSynthSetVolume] = {"sound->synth->setVolume", 2},
+    [kPDStubCallSynthPlayNote] = {"sound->synth->playNote", 3},
+
+    [kPDStubCallFileStat] = {"file->stat", 0},
+    [kPDStubCallFileOpen] = {"file->open", 1},
+    [kPDStubCallFileClose] = {"file->close", 0},
+    [kPDStubCallFileRead] = {"file->read", 1},
+    [kPDStubCallFileWrite] = {"file->write", 1},
+    [kPDStubCallFileFlush] = {"file->flush", 0},
+};
+
+#pragma mark - Recording
+
+static void record(PDStubCall call, int a0, int a1, int a2, int a3, int a4, int a5) {
+    PDStub *self = current;
+    if (self == NULL) {
+        return;
+    }
+    self->callCounts[call]++;
+    self->totalCallCounts[call]++;
+
+    if (!self->traceEnabled) {
+        return;
+    }
+    if (self->traceCount == self->traceCapacity) {
+        self->traceCapacity = self->traceCapacity == 0 ? 64 : self->traceCapacity * 2;
+        self->trace = realloc(self->trace, self->traceCapacity * sizeof(PDStubTraceEntry));
+    }
+    self->trace[self->traceCount++] = (PDStubTraceEntry) {
+        .frame = self->frame,
+        .call = call,
+        .arguments = {a0, a1, a2, a3, a4, a5},
+    };
+}
+
+#pragma mark - System
+
+static int freeLoadedFont(PDStub * _Nonnull self, void * _Nullable font);
+
+static void * _Nullable stubRealloc(void * _Nullable ptr, size_t size) {
+    record(kPDStubCallRealloc, (int) size, 0, 0, 0, 0, 0);
+    if (size == 0) {
+        if (current && freeLoadedFont(current, ptr)) {
+            return NULL;
+        }
+        free(ptr);
+        return NULL;
+    }
+    if (current) {
+        current->allocationCount++;
+    }
+    return realloc(ptr, size);
+}
+
+static void stubError(const char * _Nonnull format, ...) {
+    record(kPDStubCallError, 0, 0, 0, 0, 0, 0);
+    if (current) {
+        current->errorCount++;
+    }
+    va_list arguments;
+    va_start(arguments, format);
+    fputs("error: ", stderr);
+    vfprintf(stderr, format, arguments);
+    fputc('\n', stderr);
+    va_end(arguments);
+}
+
+static void stubLogToConsole(const char * _Nonnull format, ...) {
+    record(kPDStubCallLogToConsole, 0, 0, 0, 0, 0, 0);
+    va_list arguments;
+    va_start(arguments, format);
+    vfprintf(stderr, format, arguments);
+    fputc('\n', stderr);
+    va_end(arguments);
+}
+
+static unsigned int stubGetCurrentTimeMilliseconds(void) {
+    record(kPDStubCallGetCurrentTimeMilliseconds, 0, 0, 0, 0, 0, 0);
+    return current ? current->time : 0;
+}
+
+static void stubSetUpdateCallback(PDCallbackFunction * _Nullable update, void * _Nullable userdata) {
+    record(kPDStubCallSetUpdateCallback, 0, 0, 0, 0, 0, 0);
+    if (current) {
+        current->update = update;
+        current->updateUserdata = userdata;
+    }
+}
+
+static void stubSetButtonCallback(PDButtonCallbackFunction * _Nullable callback, void * _Nullable userdata, int queueSize) {
+    record(kPDStubCallSetButtonCallback, queueSize, 0, 0, 0, 0, 0);
+    if (current) {
+        current->buttonCallback = callback;
+        current->buttonCallbackUserdata = userdata;
+        current->buttonCallbackQueueSize = queueSize;
+    }
+}
+
+static void stubGetButtonState(PDButtons * _Nullable pressing, PDButtons * _Nullable pushed, PDButtons * _Nullable released) {
+    PDStub *self = current;
+    record(kPDStubCallGetButtonState, self ? self->buttons : 0, self ? self->pushed : 0, self ? self->released : 0, 0, 0, 0);
+    if (pressing) {
+        *pressing = self ? self->buttons : 0;
+    }
+    if (pushed) {
+        *pushed = self ? self->pushed : 0;
+    }
+    if (released) {
+        *released = self ? self->released : 0;
+    }
+}
+
+static float stubGetCrankChange(void) {
+    record(kPDStubCallGetCrankChange, 0, 0, 0, 0, 0, 0);
+    if (current == NULL) {
+        return 0.0f;
+    }
+    const float change = current->crankChange;
+    current->crankChange = 0.0f;
+    return change;
+}
+
+static float stubGetElapsedTime(void) {
+    record(kPDStubCallGetElapsedTime, 0, 0, 0, 0, 0, 0);
+    if (current == NULL) {
+        return 0.0f;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (float) (now.tv_sec - current->elapsedTimeStart.tv_sec) + (float) (now.tv_nsec - current->elapsedTimeStart.tv_nsec) / 1e9f;
+}
+
+static void stubResetElapsedTime(void) {
+    record(kPDStubCallResetElapsedTime, 0, 0, 0, 0, 0, 0);
+    if (current) {
+        clock_gettime(CLOCK_MONOTONIC, &current->elapsedTimeStart);
+    }
+}
+
+#pragma mark - Resources
+
+static char * _Nullable assetPathFor(const char * _Nonnull path, const char * _Nonnull extension) {
+    PDStub *self = current;
+    if (self == NULL || self->assetPath == NULL) {
+        return NULL;
+    }
+    const size_t length = strlen(self->assetPath) + strlen(path) + strlen(extension) + 2;
+    char *fullPath = malloc(length);
+    snprintf(fullPath, length, "%s/%s%s", self->assetPath, path, extension);
+    return fullPath;
+}
+
+#if PDSTUB_PNG
+static int loadPNG(const char * _Nonnull path, PDRasterSurface * _Nonnull surface) {
+    png_image image = {
+        .version = PNG_IMAGE_VERSION,
+    };
+    if (!png_image_begin_read_from_file(&image, path)) {
+        return 0;
+    }
+    image.format = PNG_FORMAT_GA;
+    uint8_t *pixels = malloc(PNG_IMAGE_SIZE(image));
+    if (!png_image_finish_read(&image, NULL, pixels, 0, NULL)) {
+        free(pixels);
+        png_image_free(&image);
+        return 0;
+    }
+    const int width = image.width;
+    const int height = image.height;
+    PDRasterSurfaceInit(surface, width, height, kColorBlack);
+    int hasTransparency = 0;
+    for (int index = 0; index < width * height; index++) {
+        hasTransparency |= pixels[index * 2 + 1] < 128;
+    }
+    if (hasTransparency) {
+        surface->mask = calloc(surface->rowbytes * height, 1);
+    }
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            const uint8_t *pixel = pixels + (y * width + x) * 2;
+            const int byte = y * surface->rowbytes + (x >> 3);
+            const uint8_t bit = 0x80 >> (x & 7);
+            if (pixel[0] >= 128) {
+                surface->data[byte] |= bit;
+            }
+            if (hasTransparency && pixel[1] >= 128) {
+                surface->mask[byte] |= bit;
+            }
+        }
+    }
+    free(pixels);
+    return 1;
+}
+#else
+static int loadPNG(const char * _Nonnull path, PDRasterSurface * _Nonnull surface) {
+    return 0;
+}
+#endif
+
+static uint32_t hashString(const char * _Nonnull string) {
+    uint32_t hash = 2166136261u;
+    while (*string) {
+        hash = (hash ^ (uint8_t) *string++) * 16777619u;
+    }
+    return hash;
+}
+
+/// @brief Deterministic stand-in used when the asset can't be found: a frame around a 3x5 pattern.
+static void makePlaceholderSurface(PDRasterSurface * _Nonnull surface, int width, int height, uint32_t pattern, int frame) {
+    PDRasterSurfaceInit(surface, width, height, kColorClear);
+    const int blockSize = height >= 30 ? 4 : 2;
+    const int left = (width - 3 * blockSize) / 2;
+    const int top = (height - 5 * blockSize) / 2;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            const int isFrame = frame && (x == 0 || y == 0 || x == width - 1 || y == height - 1);
+            const int blockX = (x - left) / blockSize;
+            const int blockY = (y - top) / blockSize;
+            const int isPattern = x >= left && y >= top && blockX < 3 && blockY < 5
+                && ((pattern >> (blockY * 3 + blockX)) & 1);
+            if (isFrame || isPattern) {
+                const int byte = y * surface->rowbytes + (x >> 3);
+                surface->mask[byte] |= 0x80 >> (x & 7);
+            }
+        }
+    }
+}
+
+static LCDBitmap * _Nonnull newBitmapWithSurface(PDRasterSurface surface) {
+    LCDBitmap *bitmap = malloc(sizeof(LCDBitmap));
+    *bitmap = (LCDBitmap) {
+        .surface = surface,
+    };
+    return bitmap;
+}
+
+static void freeBitmap(LCDBitmap * _Nullable bitmap) {
+    if (bitmap) {
+        PDRasterSurfaceDeinit(&bitmap->surface);
+        free(bitmap);
+    }
+}
+
+/// @brief Decodes the next character of <em>text</em>. Returns the number of bytes read.
+static int nextCharacter(const uint8_t * _Nonnull text, size_t remaining, PDStringEncoding encoding, uint32_t * _Nonnull character) {
+    if (encoding == k16BitLEEncoding) {
+        *character = remaining >= 2 ? text[0] | (text[1] << 8) : 0;
+        return 2;
+    }
+    const uint8_t first = text[0];
+    if (encoding == kASCIIEncoding || first < 0x80) {
+        *character = first;
+        return 1;
+    }
+    const int length = first >= 0xF0 ? 4 : first >= 0xE0 ? 3 : 2;
+    uint32_t value = first & (0x3F >> (length - 1));
+    for (int index = 1; index < length && index < remaining; index++) {
+        value = (value << 6) | (text[index] & 0x3F);
+    }
+    *character = value;
+    return length;
+}
+
+static PDStubGlyph * _Nullable glyphForCharacter(LCDFont * _Nonnull font, uint32_t character) {
+    if (character < 128) {
+        const int index = font->asciiIndexes[character];
+        return index >= 0 ? &font->glyphs[index] : NULL;
+    }
+    for (int index = 0; index < font->glyphCount; index++) {
+        if (font->glyphs[index].character == character) {
+            return &font->glyphs[index];
+        }
+    }
+    return NULL;
+}
+
+static void fontAddGlyph(LCDFont * _Nonnull font, uint32_t character, int advance) {
+    if (font->glyphCount == font->glyphCapacity) {
+        font->glyphCapacity = font->glyphCapacity == 0 ? 128 : font->glyphCapacity * 2;
+        font->glyphs = realloc(font->glyphs, font->glyphCapacity * sizeof(PDStubGlyph));
+    }
+    if (character < 128) {
+        font->asciiIndexes[character] = font->glyphCount;
+    }
+    font->glyphs[font->glyphCount++] = (PDStubGlyph) {
+        .character = character,
+        .advance = advance,
+    };
+}
+
+/// @brief Frees <em>font</em> if it was returned by loadFont.
+/// @return 1 if <em>font</em> was a loaded font.
+static int freeLoadedFont(PDStub * _Nonnull self, void * _Nullable font) {
+    for (LCDFont **link = &self->loadedFonts; *link; link = &(*link)->next) {
+        LCDFont *loadedFont = *link;
+        if (loadedFont != font) {
+            continue;
+        }
+        *link = loadedFont->next;
+        if (self->font == loadedFont) {
+            self->font = NULL;
+        }
+        for (unsigned int index = 0; index < self->textStateCount; index++) {
+            if (self->textStates[index].font == loadedFont) {
+                self->textStates[index].font = NULL;
+            }
+        }
+        for (int index = 0; index < loadedFont->glyphCount; index++) {
+            freeBitmap(loadedFont->glyphs[index].bitmap);
+        }
+        free(loadedFont->glyphs);
+        free(loadedFont);
+        return 1;
+    }
+    return 0;
+}
+
+/// @brief Finds "<name>-table-<width>-<height>.png" next to the .fnt file.
+static char * _Nullable findFontTable(const char * _Nonnull fntPath, int * _Nonnull cellWidth, int * _Nonnull cellHeight) {
+    const char *slash = strrchr(fntPath, '/');
+    const size_t directoryLength = slash ? slash - fntPath : 0;
+    char directory[directoryLength + 2];
+    if (slash) {
+        memcpy(directory, fntPath, directoryLength);
+        directory[directoryLength] = '\0';
+    } else {
+        strcpy(directory, ".");
+    }
+    const char *name = slash ? slash + 1 : fntPath;
+    const size_t nameLength = strlen(name) - strlen(".fnt");
+
+    DIR *dir = opendir(directory);
+    if (dir == NULL) {
+        return NULL;
+    }
+    char *tablePath = NULL;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        const char *fileName = entry->d_name;
+        if (strncmp(fileName, name, nameLength) != 0 || sscanf(fileName + nameLength, "-table-%d-%d.png", cellWidth, cellHeight) != 2) {
+            continue;
+        }
+        const size_t length = strlen(directory) + strlen(fileName) + 2;
+        tablePath = malloc(length);
+        snprintf(tablePath, length, "%s/%s", directory, fileName);
+        break;
+    }
+    closedir(dir);
+    return tablePath;
+}
+
+/// @brief Loads a .fnt file with its glyph table image. Kerning pairs are ignored.
+static int loadFontFile(LCDFont * _Nonnull font, const char * _Nonnull fntPath) {
+    FILE *file = fopen(fntPath, "r");
+    if (file == NULL) {
+        return 0;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || strncmp(line, "--", 2) == 0) {
+            continue;
+        }
+        int tracking;
+        if (sscanf(line, "tracking=%d", &tracking) == 1) {
+            font->tracking = tracking;
+            continue;
+        }
+        char *separator = strpbrk(line, "\t ");
+        if (separator == NULL || strchr(line, '=')) {
+            continue;
+        }
+        *separator = '\0';
+        const int advance = atoi(separator + 1);
+        uint32_t character;
+        if (strcmp(line, "space") == 0) {
+            character = ' ';
+        } else {
+            const int byteCount = nextCharacter((const uint8_t *) line, strlen(line), kUTF8Encoding, &character);
+            if (line[byteCount] != '\0') {
+                // Kerning pair.
+                continue;
+            }
+        }
+        fontAddGlyph(font, character, advance);
+    }
+    fclose(file);
+
+    int cellWidth;
+    int cellHeight;
+    char *tablePath = findFontTable(fntPath, &cellWidth, &cellHeight);
+    PDRasterSurface table;
+    const int hasTable = tablePath && cellWidth > 0 && cellHeight > 0 && loadPNG(tablePath, &table);
+    free(tablePath);
+    if (!hasTable) {
+        return 0;
+    }
+    font->height = cellHeight;
+    const int columns = table.width / cellWidth;
+    for (int index = 0; index < font->glyphCount; index++) {
+        const int cellX = (index % columns) * cellWidth;
+        const int cellY = (index / columns) * cellHeight;
+        PDRasterSurface glyph;
+        PDRasterSurfaceInit(&glyph, cellWidth, cellHeight, kColorClear);
+        for (int y = 0; y < cellHeight && cellY + y < table.height; y++) {
+            for (int x = 0; x < cellWidth; x++) {
+                if (!PDRasterSurfaceIsOpaque(&table, cellX + x, cellY + y)) {
+                    continue;
+                }
+                const int byte = y * glyph.rowbytes + (x >> 3);
+                const uint8_t bit = 0x80 >> (x & 7);
+                glyph.mask[byte] |= bit;
+                if (PDRasterSurfaceGetPixel(&table, cellX + x, cellY + y)) {
+                    glyph.data[byte] |= bit;
+                }
+            }
+        }
+        font->glyphs[index].bitmap = newBitmapWithSurface(glyph);
+    }
+    PDRasterSurfaceDeinit(&table);
+    return 1;
+}
+
+/// @brief Printable ASCII glyphs with a 3x5 pattern derived from the character code.
+static void loadPlaceholderFont(LCDFont * _Nonnull font) {
+    const int cellSize = 36;
+    font->height = cellSize;
+    for (uint32_t character = ' '; character < 127; character++) {
+        fontAddGlyph(font, character, 20);
+        if (character != ' ') {
+            PDRasterSurface glyph;
+            makePlaceholderSurface(&glyph, 20, cellSize, hashString((char[]) {character, '\0'}) | 1, 0);
+            font->glyphs[font->glyphCount - 1].bitmap = newBitmapWithSurface(glyph);
+        }
+    }
+}
+
+#pragma mark - Graphics
+
+static PDRaster * _Nullable currentRaster(void) {
+    PDStub *self = current;
+    return self && self->rasterEnabled ? &self->raster : NULL;
+}
+
+static void stubClear(LCDColor color) {
+    record(kPDStubCallClear, (int) color, 0, 0, 0, 0, 0);
+    PDRaster *raster = currentRaster();
+    if (raster) {
+        PDRasterClear(raster, color);
+    }
+}
+
+static LCDBitmapDrawMode stubSetDrawMode(LCDBitmapDrawMode mode) {
+    record(kPDStubCallSetDrawMode, mode, 0, 0, 0, 0, 0);
+    if (current == NULL) {
+        return kDrawModeCopy;
+    }
+    PDRasterContext *context = PDRasterGetContext(&current->raster);
+    const LCDBitmapDrawMode previousMode = context->drawMode;
+    context->drawMode = mode;
+    return previousMode;
+}
+
+static void stubSetDrawOffset(int dx, int dy) {
+    record(kPDStubCallSetDrawOffset, dx, dy, 0, 0, 0, 0);
+    if (current) {
+        PDRasterContext *context = PDRasterGetContext(&current->raster);
+        context->offsetX = dx;
+        context->offsetY = dy;
+    }
+}
+
+static void stubSetClipRect(int x, int y, int width, int height) {
+    record(kPDStubCallSetClipRect, x, y, width, height, 0, 0);
+    if (current) {
+        PDRasterSetClipRect(&current->raster, x, y, width, height);
+    }
+}
+
+static void stubClearClipRect(void) {
+    record(kPDStubCallClearClipRect, 0, 0, 0, 0, 0, 0);
+    if (current) {
+        PDRasterClearClipRect(&current->raster);
+    }
+}
+
+static void stubSetFont(LCDFont * _Nullable font) {
+    record(kPDStubCallSetFont, 0, 0, 0, 0, 0, 0);
+    if (current) {
+        current->font = font;
+    }
+}
+
+static void stubSetTextTracking(int tracking) {
+    record(kPDStubCallSetTextTracking, tracking, 0, 0, 0, 0, 0);
+    if (current) {
+        current->textTracking = tracking;
+    }
+}
+
+static int stubGetTextTracking(void) {
+    record(kPDStubCallGetTextTracking, 0, 0, 0, 0, 0, 0);
+    return current ? current->textTracking : 0;
+}
+
+static void stubSetTextLeading(int leading) {
+    record(kPDStubCallSetTextLeading, leading, 0, 0, 0, 0, 0);
+    if (current) {
+        current->textLeading = leading;
+    }
+}
+
+static void stubPushContext(LCDBitmap * _Nullable target) {
+    record(kPDStubCallPushContext, target != NULL, 0, 0, 0, 0, 0);
+    PDStub *self = current;
+    if (self) {
+        PDRasterPushContext(&self->raster, target ? &target->surface : NULL);
+        if (self->textStateCount < kPDRasterContextStackSize) {
+            self->textStates[self->textStateCount++] = (PDStubTextState) {
+                .font = self->font,
+                .textTracking = self->textTracking,
+                .textLeading = self->textLeading,
+            };
+        }
+    }
+}
+
+static void stubPopContext(void) {
+    record(kPDStubCallPopContext, 0, 0, 0, 0, 0, 0);
+    PDStub *self = current;
+    if (self) {
+        PDRasterPopContext(&self->raster);
+        if (self->textStateCount > 0) {
+            const PDStubTextState state = self->textStates[--self->textStateCount];
+            self->font = state.font;
+            self->textTracking = state.textTracking;
+            self->textLeading = state.textLeading;
+        }
+    }
+}
+
+static void stubDrawBitmap(LCDBitmap * _Nonnull bitmap, int x, int y, LCDBitmapFlip flip) {
+    record(kPDStubCallDrawBitmap, x, y, bitmap->surface.width, bitmap->surface.height, flip, 0);
+    PDRaster *raster = currentRaster();
+    if (raster) {
+        PDRasterDrawSurface(raster, &bitmap->surface, x, y, flip);
+    }
+}
+
+static void stubDrawLine(int x1, int y1, int x2, int y2, int width, LCDColor color) {
+    record(kPDStubCallDrawLine, x1, y1, x2, y2, width, (int) color);
+    PDRaster *raster = currentRaster();
+    if (raster) {
+        PDRasterDrawLine(raster, x1, y1, x2, y2, width, color);
+    }
+}
+
+static void stubDrawRect(int x, int y, int width, int height, LCDColor color) {
+    record(kPDStubCallDrawRect, x, y, width, height, (int) color, 0);
+    PDRaster *raster = currentRaster();
+    if (raster) {
+        PDRasterDrawRect(raster, x, y, width, height, color);
+    }
+}
+
+static void stubFillRect(int x, int y, int width, int height, LCDColor color) {
+    record(kPDStubCallFillRect, x, y, width, height, (int) color, 0);
+    PDRaster *raster = currentRaster();
+    if (raster) {
+        PDRasterFillRect(raster, x, y, width, height, color);
+    }
+}
+
+static int stubDrawText(const void * _Nonnull text, size_t length, PDStringEncoding encoding, int x, int y) {
+    const char firstCharacter = length > 0 ? ((const char *) text)[0] : '\0';
+    record(kPDStubCallDrawText, x, y, (int) length, encoding, firstCharacter, 0);
+    PDStub *self = current;
+    LCDFont *font = self ? self->font : NULL;
+    if (font == NULL) {
+        return 0;
+    }
+    PDRaster *raster = currentRaster();
+    const uint8_t *bytes = text;
+    int penX = x;
+    int penY = y;
+    int width = 0;
+    // length is a character count, like on device.
+    for (size_t count = 0; count < length && *bytes != '\0'; count++) {
+        uint32_t character;
+        bytes += nextCharacter(bytes, length * 4, encoding, &character);
+        if (character == '\n') {
+            penX = x;
+            penY += font->height + self->textLeading;
+            continue;
+        }
+        PDStubGlyph *glyph = glyphForCharacter(font, character);
+        if (glyph == NULL) {
+            continue;
+        }
+        if (raster && glyph->bitmap) {
+            PDRasterDrawSurface(raster, &glyph->bitmap->surface, penX, penY, kBitmapUnflipped);
+        }
+        penX += glyph->advance + font->tracking + self->textTracking;
+        width = penX - x > width ? penX - x : width;
+    }
+    return width;
+}
+
+static LCDBitmap * _Nullable stubNewBitmap(int width, int height, LCDColor color) {
+    record(kPDStubCallNewBitmap, width, height, (int) color, 0, 0, 0);
+    PDRasterSurface surface;
+    PDRasterSurfaceInit(&surface, width, height, color);
+    return newBitmapWithSurface(surface);
+}
+
+static LCDBitmap * _Nullable stubLoadBitmap(const char * _Nonnull path, const char * _Nullable * _Nullable error) {
+    record(kPDStubCallLoadBitmap, 0, 0, 0, 0, 0, 0);
+    PDRasterSurface surface;
+    char *pngPath = assetPathFor(path, ".png");
+    if (pngPath == NULL || !loadPNG(pngPath, &surface)) {
+        makePlaceholderSurface(&surface, 30, 20, hashString(path), 1);
+    }
+    free(pngPath);
+    return newBitmapWithSurface(surface);
+}
+
+static LCDBitmap * _Nullable stubCopyBitmap(LCDBitmap * _Nonnull bitmap) {
+    record(kPDStubCallCopyBitmap, 0, 0, 0, 0, 0, 0);
+    PDRasterSurface surface;
+    PDRasterSurfaceCopy(&surface, &bitmap->surface);
+    return newBitmapWithSurface(surface);
+}
+
+static void stubClearBitmap(LCDBitmap * _Nonnull bitmap, LCDColor color) {
+    record(kPDStubCallClearBitmap, (int) color, 0, 0, 0, 0, 0);
+    PDRasterSurface *surface = &bitmap->surface;
+    const size_t size = surface->rowbytes * surface->height;
+    if (color == kColorClear) {
+        if (surface->mask == NULL) {
+            surface->mask = malloc(size);
+        }
+        memset(surface->mask, 0, size);
+        memset(surface->data, 0, size);
+    } else {
+        memset(surface->data, color == kColorWhite ? 0xFF : 0, size);
+        if (surface->mask) {
+            memset(surface->mask, 0xFF, size);
+        }
+    }
+}
+
+static void stubFreeBitmap(LCDBitmap * _Nonnull bitmap) {
+    record(kPDStubCallFreeBitmap, 0, 0, 0, 0, 0, 0);
+    freeBitmap(bitmap);
+}
+
+static void stubGetBitmapData(LCDBitmap * _Nonnull bitmap, int * _Nullable width, int * _Nullable height, int * _Nullable rowbytes, uint8_t * _Nullable * _Nullable mask, uint8_t * _Nullable * _Nullable data) {
+    const PDRasterSurface *surface = &bitmap->surface;
+    record(kPDStubCallGetBitmapData, surface->width, surface->height, 0, 0, 0, 0);
+    if (width) {
+        *width = surface->width;
+    }
+    if (height) {
+        *height = surface->height;
+    }
+    if (rowbytes) {
+        *rowbytes = surface->rowbytes;
+    }
+    if (mask) {
+        *mask = surface->mask;
+    }
+    if (data) {
+        *data = surface->data;
+    }
+}
+
+static LCDFont * _Nullable stubLoadFont(const char * _Nonnull path, const char * _Nullable * _Nullable error) {
+    record(kPDStubCallLoadFont, 0, 0, 0, 0, 0, 0);
+    LCDFont *font = calloc(1, sizeof(LCDFont));
+    memset(font->asciiIndexes, -1, sizeof(font->asciiIndexes));
+    char *fntPath = assetPathFor(path, ".fnt");
+    if (fntPath == NULL || !loadFontFile(font, fntPath)) {
+        for (int index = 0; index < font->glyphCount; index++) {
+            freeBitmap(font->glyphs[index].bitmap);
+        }
+        font->glyphCount = 0;
+        font->tracking = 0;
+        memset(font->asciiIndexes, -1, sizeof(font->asciiIndexes));
+        loadPlaceholderFont(font);
+    }
+    free(fntPath);
+    if (current) {
+        font->next = current->loadedFonts;
+        current->loadedFonts = font;
+    }
+    return font;
+}
+
+static uint8_t stubGetFontHeight(LCDFont * _Nonnull font) {
+    record(kPDStubCallGetFontHeight, font->height, 0, 0, 0, 0, 0);
+    return font->height;
+}
+
+static int stubGetTextWidth(LCDFont * _Nonnull font, const void * _Nonnull text, size_t length, PDStringEncoding encoding, int tracking) {
+    record(kPDStubCallGetTextWidth, (int) length, tracking, 0, 0, 0, 0);
+    const uint8_t *bytes = text;
+    int width = 0;
+    for (size_t count = 0; count < length && *bytes != '\0'; count++) {
+        uint32_t character;
+        bytes += nextCharacter(bytes, length * 4, encoding, &character);
+        PDStubGlyph *glyph = glyphForCharacter(font, character);
+        if (glyph) {
+            width += glyph->advance + font->tracking + tracking;
+        }
+    }
+    return width > 0 ? width - font->tracking - tracking : 0;
+}
+
+static uint8_t * _Nullable stubGetFrame(void) {
+    record(kPDStubCallGetFrame, 0, 0, 0, 0, 0, 0);
+    return current ? current->raster.frame.data : NULL;
+}
+
+static void stubMarkUpdatedRows(int start, int end) {
+    record(kPDStubCallMarkUpdatedRows, start, end, 0, 0, 0, 0);
+}
+
+static void stubDisplay(void) {
+    record(kPDStubCallDisplay, 0, 0, 0, 0, 0, 0);
+}
+
+#pragma mark - Display
+
+static void stubSetRefreshRate(float rate) {
+    record(kPDStubCallSetRefreshRate, (int) rate, 0, 0, 0, 0, 0);
+}
+
+#pragma mark - Sound
+
+static AudioSample * _Nullable stubSampleLoad(const char * _Nonnull path) {
+    record(kPDStubCallSampleLoad, 0, 0, 0, 0, 0, 0);
+    return calloc(1, sizeof(AudioSample));
+}
+
+static AudioSample * _Nullable stubNewSampleFromData(uint8_t * _Nonnull data, SoundFormat format, uint32_t sampleRate, int byteCount, int shouldFreeData) {
+    record(kPDStubCallSampleNewFromData, format, (int) sampleRate, byteCount, shouldFreeData, 0, 0);
+    return calloc(1, sizeof(AudioSample));
+}
+
+static void stubFreeSample(AudioSample * _Nonnull sample) {
+    record(kPDStubCallSampleFree, 0, 0, 0, 0, 0, 0);
+    free(sample);
+}
+
+static SamplePlayer * _Nonnull stubNewPlayer(void) {
+    record(kPDStubCallSamplePlayerNew, 0, 0, 0, 0, 0, 0);
+    return calloc(1, sizeof(SamplePlayer));
+}
+
+static void stubFreePlayer(SamplePlayer * _Nonnull player) {
+    record(kPDStubCallSamplePlayerFree, 0, 0, 0, 0, 0, 0);
+    free(player);
+}
+
+static void stubSetSample(SamplePlayer * _Nonnull player, AudioSample * _Nullable sample) {
+    record(kPDStubCallSamplePlayerSetSample, 0, 0, 0, 0, 0, 0);
+    player->sample = sample;
+}
+
+static int stubPlay(SamplePlayer * _Nonnull player, int repeat, float rate) {
+    record(kPDStubCallSamplePlayerPlay, repeat, (int) (rate * 100.0f), 0, 0, 0, 0);
+    return 1;
+}
+
+static PDSynth * _Nonnull stubNewSynth(void) {
+    record(kPDStubCallSynthNew, 0, 0, 0, 0, 0, 0);
+    return calloc(1, sizeof(PDSynth));
+}
+
+static void stubFreeSynth(PDSynth * _Nonnull synth) {
+    record(kPDStubCallSynthFree, 0, 0, 0, 0, 0, 0);
+    free(synth);
+}
+
+static void stubSetWaveform(PDSynth * _Nonnull synth, SoundWaveform waveform) {
+    record(kPDStubCallSynthSetWaveform, waveform, 0, 0, 0, 0, 0);
+    synth->waveform = waveform;
+}
+
+// Envelope values are traced in milliseconds, or percents for the sustain level.
+
+static void stubSetEnvelopeTime(PDSynth * _Nonnull synth, float time) {
+    record(kPDStubCallSynthSetEnvelope, (int) (time * 1000.0f), 0, 0, 0, 0, 0);
+}
+
+static void stubSetSustainLevel(PDSynth * _Nonnull synth, float level) {
+    record(kPDStubCallSynthSetEnvelope, (int) (level * 100.0f), 0, 0, 0, 0, 0);
+}
+
+static void stubSetSynthVolume(PDSynth * _Nonnull synth, float left, float right) {
+    record(kPDStubCallSynthSetVolume, (int) (left * 100.0f), (int) (right * 100.0f), 0, 0, 0, 0);
+}
+
+static void stubPlayNote(PDSynth * _Nonnull synth, float frequency, float velocity, float length, uint32_t when) {
+    record(kPDStubCallSynthPlayNote, (int) frequency, (int) (velocity * 100.0f), (int) (length * 1000.0f), 0, 0, 0);
+}
+
+#pragma mark - File
+
+// Paths are used as is, relative to the working directory of the host process.
+
+static const char * _Nullable stubFileGetErr(void) {
+    return strerror(errno);
+}
+
+static int stubFileStat(const char * _Nonnull path, FileStat * _Nonnull result) {
+    record(kPDStubCallFileStat, 0, 0, 0, 0, 0, 0);
+    struct stat status;
+    if (stat(path, &status) != 0) {
+        return -1;
+    }
+    *result = (FileStat) {
+        .isdir = S_ISDIR(status.st_mode),
+        .size = (unsigned int) status.st_size,
+    };
+    return 0;
+}
+
+static SDFile * _Nullable stubFileOpen(const char * _Nonnull name, FileOptions mode) {
+    record(kPDStubCallFileOpen, mode, 0, 0, 0, 0, 0);
+    const char *fopenMode = "rb";
+    if (mode & kFileAppend) {
+        fopenMode = "ab";
+    } else if (mode & kFileWrite) {
+        fopenMode = "wb";
+    }
+    return fopen(name, fopenMode);
+}
+
+static int stubFileClose(SDFile * _Nonnull file) {
+    record(kPDStubCallFileClose, 0, 0, 0, 0, 0, 0);
+    return fclose(file) == 0 ? 0 : -1;
+}
+
+static int stubFileRead(SDFile * _Nonnull file, void * _Nonnull buffer, unsigned int length) {
+    record(kPDStubCallFileRead, length, 0, 0, 0, 0, 0);
+    const size_t count = fread(buffer, 1, length, file);
+    return count == 0 && ferror(file) ? -1 : (int) count;
+}
+
+static int stubFileWrite(SDFile * _Nonnull file, const void * _Nonnull buffer, unsigned int length) {
+    record(kPDStubCallFileWrite, length, 0, 0, 0, 0, 0);
+    return fwrite(buffer, 1, length, file) == length ? (int) length : -1;
+}
+
+static int stubFileFlush(SDFile * _Nonnull file) {
+    record(kPDStubCallFileFlush, 0, 0, 0, 0, 0, 0);
+    return fflush(file) == 0 ? 0 : -1;
+}
+
+#pragma mark - API tables
+
+static const struct playdate_sys systemApi = {
+    .realloc = stubRealloc,
+    .error = stubError,
+    .logToConsole = stubLogToConsole,
+    .getCurrentTimeMilliseconds = stubGetCurrentTimeMilliseconds,
+    .setUpdateCallback = stubSetUpdateCallback,
+    .setButtonCallback = stubSetButtonCallback,
+    .getButtonState = stubGetButtonState,
+    .getCrankChange = stubGetCrankChange,
+    .getElapsedTime = stubGetElapsedTime,
+    .resetElapsedTime = stubResetElapsedTime,
+};
+
+static const struct playdate_graphics graphicsApi = {
+    .clear = stubClear,
+    .setDrawMode = stubSetDrawMode,
+    .setDrawOffset = stubSetDrawOffset,
+    .setClipRect = stubSetClipRect,
+    .clearClipRect = stubClearClipRect,
+    .setFont = stubSetFont,
+    .setTextTracking = stubSetTextTracking,
+    .getTextTracking = stubGetTextTracking,
+    .setTextLeading = stubSetTextLeading,
+    .pushContext = stubPushContext,
+    .popContext = stubPopContext,
+    .drawBitmap = stubDrawBitmap,
+    .drawLine = stubDrawLine,
+    .drawRect = stubDrawRect,
+    .fillRect = stubFillRect,
+    .drawText = stubDrawText,
+    .newBitmap = stubNewBitmap,
+    .freeBitmap = stubFreeBitmap,
+    .loadBitmap = stubLoadBitmap,
+    .copyBitmap = stubCopyBitmap,
+    .getBitmapData = stubGetBitmapData,
+    .clearBitmap = stubClearBitmap,
+    .loadFont = stubLoadFont,
+    .getFontHeight = stubGetFontHeight,
+    .getTextWidth = stubGetTextWidth,
+    .getFrame = stubGetFrame,
+    .getDisplayFrame = stubGetFrame,
+    .markUpdatedRows = stubMarkUpdatedRows,
+    .display = stubDisplay,
+};
+
+static const struct playdate_display displayApi = {
+    .setRefreshRate = stubSetRefreshRate,
+};
+
+static const struct playdate_sound_sample sampleApi = {
+    .load = stubSampleLoad,
+    .newSampleFromData = stubNewSampleFromData,
+    .freeSample = stubFreeSample,
+};
+
+static const struct playdate_sound_sampleplayer samplePlayerApi = {
+    .newPlayer = stubNewPlayer,
+    .freePlayer = stubFreePlayer,
+    .setSample = stubSetSample,
+    .play = stubPlay,
+};
+
+static const struct playdate_sound_synth synthApi = {
+    .newSynth = stubNewSynth,
+    .freeSynth = stubFreeSynth,
+    .setWaveform = stubSetWaveform,
+    .setAttackTime = stubSetEnvelopeTime,
+    .setDecayTime = stubSetEnvelopeTime,
+    .setSustainLevel = stubSetSustainLevel,
+    .setReleaseTime = stubSetEnvelopeTime,
+    .setVolume = stubSetSynthVolume,
+    .playNote = stubPlayNote,
+};
+
+static const struct playdate_sound soundApi = {
+    .sample = &sampleApi,
+    .sampleplayer = &samplePlayerApi,
+    .synth = &synthApi,
+};
+
+static const struct playdate_file fileApi = {
+    .geterr = stubFileGetErr,
+    .stat = stubFileStat,
+    .open = stubFileOpen,
+    .close = stubFileClose,
+    .read = stubFileRead,
+    .write = stubFileWrite,
+    .flush = stubFileFlush,
+};
+
+#pragma mark - Public functions
+
+PDStub * _Nonnull PDStubNew(void) {
+    PDStub *self = calloc(1, sizeof(PDStub));
+    self->api = (PlaydateAPI) {
+        .system = &systemApi,
+        .file = &fileApi,
+        .graphics = &graphicsApi,
+        .display = &displayApi,
+        .sound = &soundApi,
+    };
+    self->rasterEnabled = 1;
+    PDRasterInit(&self->raster);
+    clock_gettime(CLOCK_MONOTONIC, &self->elapsedTimeStart);
+    return self;
+}
+
+void PDStubFree(PDStub * _Nonnull self) {
+    if (current == self) {
+        current = NULL;
+        playdate = NULL;
+    }
+    PDRasterDeinit(&self->raster);
+    free(self->assetPath);
+    free(self->trace);
+    free(self);
+}
+
+void PDStubMakeCurrent(PDStub * _Nonnull self) {
+    current = self;
+    playdate = &self->api;
+}
+
+PlaydateAPI * _Nonnull PDStubGetAPI(PDStub * _Nonnull self) {
+    return &self->api;
+}
+
+void PDStubSetAssetPath(PDStub * _Nonnull self, const char * _Nullable path) {
+    free(self->assetPath);
+    self->assetPath = path ? strdup(path) : NULL;
+}
+
+void PDStubSetTime(PDStub * _Nonnull self, unsigned int milliseconds) {
+    self->time = milliseconds;
+}
+
+void PDStubAdvanceTime(PDStub * _Nonnull self, unsigned int milliseconds) {
+    self->time += milliseconds;
+}
+
+unsigned int PDStubGetTime(PDStub * _Nonnull self) {
+    return self->time;
+}
+
+void PDStubSetButtons(PDStub * _Nonnull self, PDButtons buttons) {
+    self->buttons = buttons;
+}
+
+void PDStubSetButtonState(PDStub * _Nonnull self, PDButtons current, PDButtons pushed, PDButtons released) {
+    self->buttons = current;
+    self->buttonStateForced = 1;
+    self->forcedPushed = pushed;
+    self->forcedReleased = released;
+}
+
+void PDStubSetCrankChange(PDStub * _Nonnull self, float change) {
+    self->crankChange = change;
+}
+
+void PDStubQueueButtonEvent(PDStub * _Nonnull self, PDButtons button, int down, unsigned int when) {
+    if (self->buttonEventCount < kPDStubButtonEventCapacity) {
+        self->buttonEvents[self->buttonEventCount++] = (PDStubButtonEvent) {button, down, when};
+    }
+}
+
+void PDStubBeginFrame(PDStub * _Nonnull self) {
+    self->frame++;
+    if (self->buttonStateForced) {
+        self->pushed = self->forcedPushed;
+        self->released = self->forcedReleased;
+        self->buttonStateForced = 0;
+    } else {
+        self->pushed = self->buttons & ~self->previousButtons;
+        self->released = self->previousButtons & ~self->buttons;
+    }
+    self->previousButtons = self->buttons;
+    memset(self->callCounts, 0, sizeof(self->callCounts));
+    self->traceCount = 0;
+    self->raster.pixelsWritten = 0;
+    self->allocationCount = 0;
+    // At most the queue size given to setButtonCallback is delivered, the other events are dropped.
+    const unsigned int queueSize = self->buttonCallbackQueueSize > 0 ? self->buttonCallbackQueueSize : 0;
+    for (unsigned int index = 0; index < self->buttonEventCount && index < queueSize; index++) {
+        const PDStubButtonEvent event = self->buttonEvents[index];
+        if (self->buttonCallback) {
+            self->buttonCallback(event.button, event.down, event.when, self->buttonCallbackUserdata);
+        }
+    }
+    self->buttonEventCount = 0;
+}
+
+int PDStubRunFrame(PDStub * _Nonnull self) {
+    PDStubBeginFrame(self);
+    if (self->update == NULL) {
+        return 0;
+    }
+    return self->update(self->updateUserdata);
+}
+
+unsigned int PDStubGetFrameIndex(PDStub * _Nonnull self) {
+    return self->frame;
+}
+
+const char * _Nonnull PDStubCallName(PDStubCall call) {
+    return call < kPDStubCallCount ? callInfos[call].name : "unknown";
+}
+
+unsigned int PDStubGetCallCount(PDStub * _Nonnull self, PDStubCall call) {
+    return self->callCounts[call];
+}
+
+unsigned int PDStubGetFrameCallCount(PDStub * _Nonnull self) {
+    unsigned int count = 0;
+    for (unsigned int index = 0; index < kPDStubCallCount; index++) {
+        count += self->callCounts[index];
+    }
+    return count;
+}
+
+unsigned long PDStubGetTotalCallCount(PDStub * _Nonnull self, PDStubCall call) {
+    return self->totalCallCounts[call];
+}
+
+unsigned int PDStubGetAllocationCount(PDStub * _Nonnull self) {
+    return self->allocationCount;
+}
+
+unsigned int PDStubGetErrorCount(PDStub * _Nonnull self) {
+    return self->errorCount;
+}
+
+void PDStubSetRasterEnabled(PDStub * _Nonnull self, int enabled) {
+    self->rasterEnabled = enabled;
+}
+
+unsigned long PDStubGetPixelsWritten(PDStub * _Nonnull self) {
+    return self->raster.pixelsWritten;
+}
+
+uint64_t PDStubGetFrameHash(PDStub * _Nonnull self) {
+    return PDRasterSurfaceHash(&self->raster.frame);
+}
+
+int PDStubWriteFrame(PDStub * _Nonnull self, FILE * _Nonnull output) {
+    return PDRasterSurfaceWritePBM(&self->raster.frame, output);
+}
+
+void PDStubSetTraceEnabled(PDStub * _Nonnull self, int enabled) {
+    self->traceEnabled = enabled;
+}
+
+const PDStubTraceEntry * _Nullable PDStubGetTrace(PDStub * _Nonnull self, unsigned int * _Nonnull count) {
+    *count = self->traceCount;
+    return self->trace;
+}
+
+void PDStubDumpFrame(PDStub * _Nonnull self, FILE * _Nonnull output) {
+    fprintf(output, "frame %u: %u calls, %lu pixels written, hash %016llx\n", self->frame, PDStubGetFrameCallCount(self),
+            self->raster.pixelsWritten, (unsigned long long) PDStubGetFrameHash(self));
+    for (unsigned int index = 0; index < kPDStubCallCount; index++) {
+        if (self->callCounts[index] > 0) {
+            fprintf(output, "  %-36s %u\n", callInfos[index].name, self->callCounts[index]);
+        }
+    }
+    for (unsigned int index = 0; index < self->traceCount; index++) {
+        const PDStubTraceEntry entry = self->trace[index];
+        fprintf(output, "    %s(", callInfos[entry.call].name);
+        for (int argument = 0; argument < callInfos[entry.call].argumentCount; argument++) {
+            fprintf(output, argument == 0 ? "%d" : ", %d", entry.arguments[argument]);
+        }
+        fputs(")\n", output);
+    }
+}
@@ -0,0 +1,240 @@
+//
+//  pd_stub.h
+//  pd-keyboard
+//
+//  Created by agent on 16/10/2026.
+//
+
+#ifndef pd_stub_h
+#define pd_stub_h
+
+#include <stdio.h>
+
+#include "pd_api.h"
+
+#ifndef PDKEYBOARD_THREAD_LOCAL
+#define PDKEYBOARD_THREAD_LOCAL
+#endif
+
+/**
+ * Each thread has its own current stub when built with
+ * <code>PDKEYBOARD_THREAD_LOCAL=_Thread_local</code>.
+ */
+extern PDKEYBOARD_THREAD_LOCAL PlaydateAPI * _Nullable playdate;
+
+typedef struct pdstub PDStub;
+
+/**
+ * Every PlaydateAPI entry point implemented by the stub. Each call is counted
+ * per frame and, when tracing is enabled, recorded with its arguments.
+ */
+typedef enum {
+    kPDStubCallRealloc,
+    kPDStubCallError,
+    kPDStubCallLogToConsole,
+    kPDStubCallGetCurrentTimeMilliseconds,
+    kPDStubCallSetUpdateCallback,
+    kPDStubCallSetButtonCallback,
+    kPDStubCallGetButtonState,
+    kPDStubCallGetCrankChange,
+    kPDStubCallGetElapsedTime,
+    kPDStubCallResetElapsedTime,
+
+    kPDStubCallClear,
+    kPDStubCallSetDrawMode,
+    kPDStubCallSetDrawOffset,
+    kPDStubCallSetClipRect,
+    kPDStubCallClearClipRect,
+    kPDStubCallSetFont,
+    kPDStubCallSetTextTracking,
+    kPDStubCallGetTextTracking,
+    kPDStubCallSetTextLeading,
+    kPDStubCallPushContext,
+    kPDStubCallPopContext,
+    kPDStubCallDrawBitmap,
+    kPDStubCallDrawLine,
+    kPDStubCallDrawRect,
+    kPDStubCallFillRect,
+    kPDStubCallDrawText,
+    kPDStubCallNewBitmap,
+    kPDStubCallLoadBitmap,
+    kPDStubCallCopyBitmap,
+    kPDStubCallClearBitmap,
+    kPDStubCallFreeBitmap,
+    kPDStubCallGetBitmapData,
+    kPDStubCallLoadFont,
+    kPDStubCallGetFontHeight,
+    kPDStubCallGetTextWidth,
+    kPDStubCallGetFrame,
+    kPDStubCallMarkUpdatedRows,
+    kPDStubCallDisplay,
+
+    kPDStubCallSetRefreshRate,
+
+    kPDStubCallSampleLoad,
+    kPDStubCallSampleNewFromData,
+    kPDStubCallSampleFree,
+    kPDStubCallSamplePlayerNew,
+    kPDStubCallSamplePlayerFree,
+    kPDStubCallSamplePlayerSetSample,
+    kPDStubCallSamplePlayerPlay,
+    kPDStubCallSynthNew,
+    kPDStubCallSynthFree,
+    kPDStubCallSynthSetWaveform,
+    kPDStubCallSynthSetEnvelope,
+    kPDStubCallSynthSetVolume,
+    kPDStubCallSynthPlayNote,
+
+    kPDStubCallFileStat,
+    kPDStubCallFileOpen,
+    kPDStubCallFileClose,
+    kPDStubCallFileRead,
+    kPDStubCallFileWrite,
+    kPDStubCallFileFlush,
+} PDStubCall;
+#define kPDStubCallCount (kPDStubCallFileFlush + 1)
+
+#define kPDStubTraceArgumentCount 6
+
+typedef struct {
+    unsigned int frame;
+    PDStubCall call;
+    int arguments[kPDStubTraceArgumentCount];
+} PDStubTraceEntry;
+
+/**
+ * Allocates a new stub. The stub owns a PlaydateAPI instance that can be made
+ * the current <code>playdate</code> pointer with <code>PDStubMakeCurrent</code>.
+ */
+PDStub * _Nonnull PDStubNew(void);
+void PDStubFree(PDStub * _Nonnull self);
+
+/**
+ * Makes <em>self</em> the context used by the stubbed entry points and sets the
+ * global <code>playdate</code> pointer to its API.
+ */
+void PDStubMakeCurrent(PDStub * _Nonnull self);
+PlaydateAPI * _Nonnull PDStubGetAPI(PDStub * _Nonnull self);
+
+/**
+ * Sets the folder used to resolve asset paths, usually the SDK folder since it
+ * contains <code>CoreLibs</code>. Bitmaps are read from PNG files (when built
+ * with libpng) and fonts from .fnt files with their table image. Assets that
+ * can't be found are replaced by deterministic placeholders.
+ */
+void PDStubSetAssetPath(PDStub * _Nonnull self, const char * _Nullable path);
+
+#pragma mark - Scripted input
+
+void PDStubSetTime(PDStub * _Nonnull self, unsigned int milliseconds);
+void PDStubAdvanceTime(PDStub * _Nonnull self, unsigned int milliseconds);
+unsigned int PDStubGetTime(PDStub * _Nonnull self);
+
+/**
+ * Sets the buttons held down for the next frames. Pushed and released buttons
+ * are derived from the previous frame state when the next frame begins.
+ */
+void PDStubSetButtons(PDStub * _Nonnull self, PDButtons buttons);
+
+/**
+ * Sets the exact button state of the next frame, including pushed and released
+ * buttons. Used to replay recordings where a button may be pushed and released
+ * during the same frame.
+ */
+void PDStubSetButtonState(PDStub * _Nonnull self, PDButtons current, PDButtons pushed, PDButtons released);
+
+/**
+ * Sets the value returned by the next <code>getCrankChange</code> call. Like on
+ * device, the change is consumed by the call and later reads return 0.
+ */
+void PDStubSetCrankChange(PDStub * _Nonnull self, float change);
+
+/**
+ * Queues a button event given to the callback registered with
+ * <code>setButtonCallback</code> when the next frame begins, like on device where
+ * the events of an update cycle are delivered before the next update. The state
+ * returned by <code>getButtonState</code> is not changed.
+ */
+void PDStubQueueButtonEvent(PDStub * _Nonnull self, PDButtons button, int down, unsigned int when);
+
+#pragma mark - Frames
+
+/**
+ * Latches button edges, delivers the queued button events and resets the
+ * per-frame counters and trace.
+ */
+void PDStubBeginFrame(PDStub * _Nonnull self);
+
+/**
+ * Begins a new frame and calls the update callback registered with
+ * <code>setUpdateCallback</code>. Returns the value returned by the callback.
+ */
+int PDStubRunFrame(PDStub * _Nonnull self);
+
+unsigned int PDStubGetFrameIndex(PDStub * _Nonnull self);
+
+#pragma mark - Counters
+
+const char * _Nonnull PDStubCallName(PDStubCall call);
+
+/**
+ * Returns the number of calls to <em>call</em> since the current frame began.
+ */
+unsigned int PDStubGetCallCount(PDStub * _Nonnull self, PDStubCall call);
+
+/**
+ * Returns the number of calls to any entry point since the current frame began.
+ */
+unsigned int PDStubGetFrameCallCount(PDStub * _Nonnull self);
+
+/**
+ * Returns the number of calls to <em>call</em> since the stub was created.
+ */
+unsigned long PDStubGetTotalCallCount(PDStub * _Nonnull self, PDStubCall call);
+
+/**
+ * Returns the number of <code>realloc</code> calls that allocated or resized a
+ * block since the current frame began. Calls freeing a block are not counted.
+ */
+unsigned int PDStubGetAllocationCount(PDStub * _Nonnull self);
+
+unsigned int PDStubGetErrorCount(PDStub * _Nonnull self);
+
+#pragma mark - Frame buffer
+
+/**
+ * Enables or disables the 400x240 1-bit software rasterizer. Enabled by default.
+ * Calls are still counted when disabled.
+ */
+void PDStubSetRasterEnabled(PDStub * _Nonnull self, int enabled);
+
+/**
+ * Returns the number of pixels written by draw calls since the current frame began.
+ */
+unsigned long PDStubGetPixelsWritten(PDStub * _Nonnull self);
+
+/**
+ * Returns a hash of the frame buffer, suitable for golden image comparisons.
+ */
+uint64_t PDStubGetFrameHash(PDStub * _Nonnull self);
+
+/**
+ * Writes the frame buffer as a binary PBM image. Returns 0 on success.
+ */
+int PDStubWriteFrame(PDStub * _Nonnull self, FILE * _Nonnull output);
+
+#pragma mark - Trace
+
+void PDStubSetTraceEnabled(PDStub * _Nonnull self, int enabled);
+
+/**
+ * Returns the calls recorded since the current frame began.
+ */
+const PDStubTraceEntry * _Nullable PDStubGetTrace(PDStub * _Nonnull self, unsigned int * _Nonnull count);
+
+/**
+ * Prints the call counts and the trace of the current frame.
+ */
+void PDStubDumpFrame(PDStub * _Nonnull self, FILE * _Nonnull output);
+
+#endif /* pd_stub_h */
@@ -0,0 +1,456 @@
+//
+//  replay.c
+//  pd-keyboard
+//
+//  Created by agent on 16/10/2026.
+//
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "pd_stub.h"
+#include "keyboard.h"
+
+// Must match the record tags written by keyboard.c.
+typedef enum {
+    kRecordFrame = 1,
+    kRecordCrankFrame = 2,
+    kRecordIdleFrame = 3,
+    kRecordShow = 4,
+    kRecordHide = 5,
+    kRecordRefreshRate = 6,
+    kRecordCapitalization = 7,
+    kRecordSlideStyle = 8,
+    kRecordCrankProfile = 9,
+    kRecordButtonEvents = 10,
+    kRecordInputMode = 11,
+} RecordTag;
+
+typedef struct {
+    PDButtons button;
+    int down;
+    unsigned int time;
+} ButtonEvent;
+
+typedef struct {
+    RecordTag tag;
+    unsigned int time;
+    PDButtons current;
+    PDButtons pushed;
+    PDButtons released;
+    float crankChange;
+    float refreshRate;
+    PDKeyboardCapitalization capitalization;
+    PDKeyboardSlideStyle slideStyle;
+    PDKeyboardCrankProfile crankProfile;
+    PDKeyboardInputMode inputMode;
+    char * _Nullable text;
+    unsigned int textLength;
+    ButtonEvent * _Nullable events;
+    unsigned int eventCount;
+} Record;
+
+typedef struct {
+    unsigned int startTime;
+    float refreshRate;
+    PDKeyboardCapitalization capitalization;
+    Record * _Nullable records;
+    unsigned int count;
+    unsigned int capacity;
+} Recording;
+
+typedef struct {
+    PDStub * _Nonnull stub;
+    PDKeyboard * _Nonnull keyboard;
+    const Recording * _Nonnull recording;
+    unsigned int cursor;
+    unsigned int pendingEnd;
+    int dirtyRectTracking;
+    unsigned long dirtyArea;
+} Replay;
+
+#pragma mark - Parsing
+
+static int readByte(FILE * _Nonnull input, uint8_t * _Nonnull value) {
+    const int byte = fgetc(input);
+    *value = byte;
+    return byte == EOF ? -1 : 0;
+}
+
+static int readUInt32(FILE * _Nonnull input, uint32_t * _Nonnull value) {
+    uint8_t bytes[4];
+    if (fread(bytes, 1, sizeof(bytes), input) != sizeof(bytes)) {
+        return -1;
+    }
+    *value = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t) bytes[3] << 24);
+    return 0;
+}
+
+static int readFloat(FILE * _Nonnull input, float * _Nonnull value) {
+    uint32_t bits;
+    if (readUInt32(input, &bits)) {
+        return -1;
+    }
+    memcpy(value, &bits, sizeof(bits));
+    return 0;
+}
+
+static int readVarint(FILE * _Nonnull input, uint32_t * _Nonnull value) {
+    *value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        uint8_t byte;
+        if (readByte(input, &byte)) {
+            return -1;
+        }
+        *value |= (uint32_t) (byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int readZigzag(FILE * _Nonnull input, int32_t * _Nonnull value) {
+    uint32_t bits;
+    if (readVarint(input, &bits)) {
+        return -1;
+    }
+    *value = (int32_t) ((bits >> 1) ^ -(bits & 1));
+    return 0;
+}
+
+static int readRecord(FILE * _Nonnull input, Record * _Nonnull record, unsigned int * _Nonnull time) {
+    int32_t timeDelta;
+    if (readZigzag(input, &timeDelta)) {
+        return -1;
+    }
+    *time += (unsigned int) timeDelta;
+    record->time = *time;
+
+    uint32_t delta;
+    uint8_t bytes[3];
+    switch (record->tag) {
+        case kRecordIdleFrame:
+        case kRecordHide:
+            return 0;
+        case kRecordFrame:
+        case kRecordCrankFrame:
+            if (fread(bytes, 1, sizeof(bytes), input) != sizeof(bytes)) {
+                return -1;
+            }
+            record->current = bytes[0];
+            record->pushed = bytes[1];
+            record->released = bytes[2];
+            return record->tag == kRecordCrankFrame ? readFloat(input, &record->crankChange) : 0;
+        case kRecordShow:
+            if (readVarint(input, &delta)) {
+                return -1;
+            }
+            record->textLength = delta;
+            record->text = malloc(delta + 1);
+            record->text[delta] = '\0';
+            return fread(record->text, 1, delta, input) == delta ? 0 : -1;
+        case kRecordRefreshRate:
+            return readFloat(input, &record->refreshRate);
+        case kRecordCapitalization:
+            if (readByte(input, bytes)) {
+                return -1;
+            }
+            record->capitalization = bytes[0];
+            return 0;
+        case kRecordSlideStyle:
+            if (readByte(input, bytes)) {
+                return -1;
+            }
+            record->slideStyle = bytes[0];
+            return 0;
+        case kRecordCrankProfile:
+            if (readFloat(input, &record->crankProfile.sensitivity) || readVarint(input, &delta)) {
+                return -1;
+            }
+            record->crankProfile.ticksPerRevolution = delta;
+            if (readVarint(input, &delta)) {
+                return -1;
+            }
+            record->crankProfile.maxClicksPerFrame = delta;
+            return 0;
+        case kRecordButtonEvents:
+            if (readVarint(input, &delta) || delta > 256) {
+                return -1;
+            }
+            record->eventCount = delta;
+            record->events = malloc(delta * sizeof(ButtonEvent));
+            for (unsigned int index = 0; index < record->eventCount; index++) {
+                ButtonEvent *event = &record->events[index];
+                if (fread(bytes, 1, 2, input) != 2 || readZigzag(input, &timeDelta)) {
+                    return -1;
+                }
+                event->button = bytes[0];
+                event->down = bytes[1];
+                event->time = record->time + timeDelta;
+            }
+            return 0;
+        case kRecordInputMode:
+            if (readByte(input, bytes)) {
+                return -1;
+            }
+            record->inputMode = bytes[0];
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+static int RecordingLoad(Recording * _Nonnull self, const char * _Nonnull path) {
+    FILE *input = fopen(path, "rb");
+    if (input == NULL) {
+        perror(path);
+        return -1;
+    }
+    *self = (Recording) {};
+
+    char magic[4];
+    uint8_t version;
+    uint8_t capitalization;
+    if (fread(magic, 1, sizeof(magic), input) != sizeof(magic) || memcmp(magic, "PDKR", sizeof(magic))
+        || readByte(input, &version) || version != 1
+        || readUInt32(input, &self->startTime)
+        || readFloat(input, &self->refreshRate)
+        || readByte(input, &capitalization)) {
+        fprintf(stderr, "%s: not a keyboard recording\n", path);
+        fclose(input);
+        return -1;
+    }
+    self->capitalization = capitalization;
+
+    unsigned int time = self->startTime;
+    uint8_t tag;
+    while (!readByte(input, &tag)) {
+        if (self->count == self->capacity) {
+            self->capacity = self->capacity ? self->capacity * 2 : 256;
+            self->records = realloc(self->records, self->capacity * sizeof(Record));
+        }
+        Record *record = &self->records[self->count];
+        *record = (Record) {
+            .tag = tag,
+        };
+        if (readRecord(input, record, &time)) {
+            fprintf(stderr, "%s: truncated or invalid record %u\n", path, self->count);
+            free(record->text);
+            free(record->events);
+            fclose(input);
+            return -1;
+        }
+        self->count++;
+    }
+    fclose(input);
+    return 0;
+}
+
+static void RecordingDeinit(Recording * _Nonnull self) {
+    for (unsigned int index = 0; index < self->count; index++) {
+        free(self->records[index].text);
+        free(self->records[index].events);
+    }
+    free(self->records);
+}
+
+static int isFrame(const Record * _Nonnull record) {
+    return record->tag == kRecordFrame || record->tag == kRecordCrankFrame || record->tag == kRecordIdleFrame;
+}
+
+#pragma mark - Replay
+
+static int hostUpdate(void * _Nullable userdata) {
+    Replay *self = userdata;
+
+    // API calls made by the app during this frame.
+    const unsigned int frameTime = PDStubGetTime(self->stub);
+    for (; self->cursor < self->pendingEnd; self->cursor++) {
+        const Record *record = &self->recording->records[self->cursor];
+        PDStubSetTime(self->stub, record->time);
+        switch (record->tag) {
+            case kRecordShow:
+                keyboardApi.show(self->keyboard, record->text, record->textLength);
+                break;
+            case kRecordHide:
+                keyboardApi.hide(self->keyboard);
+                break;
+            case kRecordRefreshRate:
+                keyboardApi.setRefreshRate(self->keyboard, record->refreshRate);
+                break;
+            case kRecordCapitalization:
+                keyboardApi.setCapitalizationBehavior(self->keyboard, record->capitalization);
+                break;
+            case kRecordSlideStyle:
+                keyboardApi.setSlideStyle(self->keyboard, record->slideStyle);
+                break;
+            case kRecordCrankProfile:
+                keyboardApi.setCrankProfile(self->keyboard, &record->crankProfile);
+                break;
+            case kRecordInputMode:
+                keyboardApi.setInputMode(self->keyboard, record->inputMode);
+                break;
+            default:
+                break;
+        }
+    }
+    PDStubSetTime(self->stub, frameTime);
+
+    if (self->dirtyRectTracking && keyboardApi.isVisible(self->keyboard)) {
+        // Only redraw the area left of the keyboard, like a game using getDirtyRect.
+        const LCDRect dirtyRect = keyboardApi.getDirtyRect(self->keyboard);
+        self->dirtyArea += (dirtyRect.right - dirtyRect.left) * (dirtyRect.bottom - dirtyRect.top);
+        playdate->graphics->fillRect(0, 0, keyboardApi.getLeft(self->keyboard), LCD_ROWS, kColorWhite);
+    } else {
+        playdate->graphics->clear(kColorWhite);
+    }
+    return 1;
+}
+
+static void usage(const char * _Nonnull name) {
+    fprintf(stderr, "usage: %s [-a asset folder] [-d] [-v] [-w hashes | -c hashes] recording\n", name);
+    fprintf(stderr, "Replays a recording made with keyboardApi.startRecording against the host stub.\n");
+    fprintf(stderr, "  -a  folder containing CoreLibs, defaults to $PLAYDATE_SDK_PATH\n");
+    fprintf(stderr, "  -d  enable dirty rect tracking and only clear the screen left of the keyboard\n");
+    fprintf(stderr, "  -v  print the PlaydateAPI calls made by each frame\n");
+    fprintf(stderr, "  -w  write the frame buffer hash of each frame to the given file\n");
+    fprintf(stderr, "  -c  compare the frame buffer hashes with the given file, exit with 1 on mismatch\n");
+}
+
+int main(int argc, char * _Nonnull argv[]) {
+    const char *assetPath = getenv("PLAYDATE_SDK_PATH");
+    const char *hashOutputPath = NULL;
+    const char *hashInputPath = NULL;
+    int verbose = 0;
+    int dirtyRectTracking = 0;
+
+    int option;
+    while ((option = getopt(argc, argv, "a:dvw:c:h")) != -1) {
+        switch (option) {
+            case 'a':
+                assetPath = optarg;
+                break;
+            case 'd':
+                dirtyRectTracking = 1;
+                break;
+            case 'v':
+                verbose = 1;
+                break;
+            case 'w':
+                hashOutputPath = optarg;
+                break;
+            case 'c':
+                hashInputPath = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return option == 'h' ? 0 : 1;
+        }
+    }
+    if (optind != argc - 1 || (hashOutputPath && hashInputPath)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    Recording recording;
+    if (RecordingLoad(&recording, argv[optind])) {
+        return 1;
+    }
+
+    FILE *hashFile = NULL;
+    if (hashOutputPath || hashInputPath) {
+        hashFile = fopen(hashOutputPath ? hashOutputPath : hashInputPath, hashOutputPath ? "w" : "r");
+        if (hashFile == NULL) {
+            perror(hashOutputPath ? hashOutputPath : hashInputPath);
+            RecordingDeinit(&recording);
+            return 1;
+        }
+    }
+
+    PDStub *stub = PDStubNew();
+    PDStubMakeCurrent(stub);
+    PDStubSetAssetPath(stub, assetPath);
+    PDStubSetTime(stub, recording.startTime);
+
+    Replay replay = {
+        .stub = stub,
+        .keyboard = keyboardApi.newKeyboard(),
+        .recording = &recording,
+        .dirtyRectTracking = dirtyRectTracking,
+    };
+    playdate->system->setUpdateCallback(hostUpdate, &replay);
+    keyboardApi.setPlaydateUpdateCallback(replay.keyboard, hostUpdate, &replay);
+    keyboardApi.setRefreshRate(replay.keyboard, recording.refreshRate);
+    keyboardApi.setCapitalizationBehavior(replay.keyboard, recording.capitalization);
+    keyboardApi.setDirtyRectTrackingEnabled(replay.keyboard, dirtyRectTracking);
+
+    unsigned int frameCount = 0;
+    unsigned int mismatchCount = 0;
+    while (replay.cursor < recording.count) {
+        unsigned int next = replay.cursor;
+        while (next < recording.count && !isFrame(&recording.records[next])) {
+            next++;
+        }
+        replay.pendingEnd = next;
+
+        if (keyboardApi.isVisible(replay.keyboard) && next < recording.count) {
+            const Record *frame = &recording.records[next];
+            PDStubSetTime(stub, frame->time);
+            PDStubSetButtonState(stub, frame->current, frame->pushed, frame->released);
+            PDStubSetCrankChange(stub, frame->crankChange);
+            for (unsigned int index = replay.cursor; index < next; index++) {
+                const Record *record = &recording.records[index];
+                for (unsigned int event = 0; record->tag == kRecordButtonEvents && event < record->eventCount; event++) {
+                    PDStubQueueButtonEvent(stub, record->events[event].button, record->events[event].down, record->events[event].time);
+                }
+            }
+            PDStubRunFrame(stub);
+            replay.cursor = next + 1;
+        } else if (next == replay.cursor) {
+            fprintf(stderr, "record %u: frame recorded while the keyboard is hidden, skipped\n", replay.cursor);
+            replay.cursor++;
+            continue;
+        } else {
+            // Keyboard is hidden, the app made the calls from its own update.
+            PDStubSetTime(stub, recording.records[replay.cursor].time);
+            PDStubSetButtonState(stub, 0, 0, 0);
+            PDStubRunFrame(stub);
+        }
+        frameCount++;
+        if (verbose) {
+            PDStubDumpFrame(stub, stdout);
+        }
+
+        const uint64_t hash = PDStubGetFrameHash(stub);
+        if (hashOutputPath) {
+            fprintf(hashFile, "%016" PRIx64 "\n", hash);
+        } else if (hashInputPath) {
+            uint64_t expectedHash;
+            if (fscanf(hashFile, "%" SCNx64, &expectedHash) != 1 || expectedHash != hash) {
+                fprintf(stderr, "frame %u: hash %016" PRIx64 " does not match golden frame\n", PDStubGetFrameIndex(stub), hash);
+                mismatchCount++;
+            }
+        }
+    }
+    if (hashFile) {
+        fclose(hashFile);
+    }
+
+    char *text = NULL;
+    unsigned int textLength = 0;
+    keyboardApi.getText(replay.keyboard, &text, &textLength);
+    printf("frames: %u\n", frameCount);
+    printf("text: \"%.*s\" (%u bytes)\n", (int) textLength, text ? text : "", textLength);
+    printf("last frame hash: %016" PRIx64 "\n", PDStubGetFrameHash(stub));
+    if (dirtyRectTracking) {
+        printf("dirty rect: %lu pixels/frame\n", frameCount ? replay.dirtyArea / frameCount : 0);
+    }
+
+    keyboardApi.freeKeyboard(replay.keyboard);
+    RecordingDeinit(&recording);
+    const unsigned int errorCount = PDStubGetErrorCount(stub);
+    PDStubFree(stub);
+    return errorCount > 0 || mismatchCount > 0;
+}
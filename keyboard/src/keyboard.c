@@ -17,8 +17,34 @@ typedef enum {
     kAnimationTypeKeyboardHide,
     kAnimationTypeSelectionUp,
     kAnimationTypeSelectionDown,
+    kAnimationTypeSelectionJiggle,
 } PDKeyboardAnimationType;
 
+/// Animations of different channels run at the same time, starting an animation replaces the one of its channel.
+typedef enum {
+    /// Show and hide slides, the value is the left of the keyboard.
+    kAnimationChannelSlide,
+    /// Vertical offset of a column in fixed point, see getScrollChannel.
+    kAnimationChannelScrollSymbols,
+    kAnimationChannelScrollLetters,
+    kAnimationChannelScrollMenu,
+    /// Direction of a selection jiggle or shift, -1 or 1.
+    kAnimationChannelRowShift,
+    kAnimationChannelRowJiggle,
+    kAnimationChannelColumnJiggle,
+} PDKeyboardAnimationChannel;
+#define kAnimationChannelCount 7
+
+typedef enum {
+    /// From <code>from</code> to <code>to</code>, linearly, in fixed point.
+    kEasingLinear,
+    /// showSlideLefts and hideSlideLefts.
+    kEasingShowSlide,
+    kEasingHideSlide,
+    /// <code>from</code> during the whole animation.
+    kEasingStep,
+} PDKeyboardEasing;
+
 typedef enum {
     kColumnSymbols,
     kColumnUpper,
@@ -34,11 +60,36 @@ typedef enum {
     kMenuOptionCancel,
 } PDKeyboardMenuOption;
 
+typedef enum {
+    kSoundColumnMoveNext,
+    kSoundColumnMovePrevious,
+    kSoundRowMove,
+    kSoundBump,
+    kSoundKeyPress,
+} PDKeyboardSound;
+#define kSoundCount 5
+
+/// The crank retriggers the row click faster than it lasts, it is played by several voices in turn.
+#define kRowMoveVoiceCount 3
+#define kVoiceCount (kSoundCount - 1 + kRowMoveVoiceCount)
+
 typedef enum {
     kJiggleLeft = -1,
     kJiggleRight = 1
 } PDKeyboardJiggleDirection;
 
+typedef struct {
+    PDKeyboardAnimationType type;
+    PDKeyboardEasing easing;
+    unsigned int startTime;
+    unsigned int duration;
+    int from;
+    /// Value once the animation ended.
+    int to;
+    /// Value at the time of the last update, <code>to</code> when the animation is not running.
+    int value;
+} PDKeyboardAnimation;
+
 typedef struct {
     char * _Nullable data;
     unsigned int count;
@@ -47,15 +98,18 @@ typedef struct {
 typedef struct {
     PDKeyboardText super;
     unsigned int capacity;
+#if PDKEYBOARD_STATS
+    unsigned int reallocCount;
+#endif
 } PDKeyboardMutableText;
 
 struct size {
-    float width;
-    float height;
+    int width;
+    int height;
 };
 struct point {
-    float x;
-    float y;
+    int x;
+    int y;
 };
 struct rectangle {
     struct point origin;
@@ -67,11 +121,104 @@ struct int_size {
     int height;
 };
 
+/// Positions of everything drawn by drawKeyboard during a frame.
+typedef struct {
+    bool_t animating;
+    struct rectangle keyboardRect;
+    struct rectangle selectedRect;
+    int columnOffsets[kColumnCount];
+    /// Scroll offsets in fixed point, see kFixedShift.
+    int columnYOffsets[kColumnCount];
+    int8_t selectionIndexes[kColumnCount];
+} PDKeyboardLayout;
+
+typedef enum {
+    /// Fills width x height pixels at (x, y) with value as color.
+    kDrawOpFillRect,
+    /// Draws a line from x to x + width at y with value as color.
+    kDrawOpHorizontalLine,
+    /// Sets value as the draw mode of the next images and glyphs.
+    kDrawOpDrawMode,
+    /// Draws the menu image at index value with its top left corner at (x, y).
+    kDrawOpMenuImage,
+    /// Draws count rows of the column, from glyph index value with its top at y, cut height pixels below.
+    kDrawOpColumnRows,
+} PDKeyboardDrawOpType;
+
+typedef struct {
+    int16_t x;
+    int16_t y;
+    int16_t width;
+    int16_t height;
+    uint8_t type;
+    /// Column drawn by the op, kColumnCount for the background and the selection.
+    uint8_t column;
+    uint8_t value;
+    uint8_t count;
+} PDKeyboardDrawOp;
+
+/// The whole keyboard takes less than 50 ops, 2 or 3 runs of rows per column.
+#define kRenderListCapacity 64
+
+/// Draw ops of a layout, built again when the layout or the selected column change.
+typedef struct {
+    PDKeyboardDrawOp ops[kRenderListCapacity];
+    unsigned int count;
+    bool_t isValid;
+    PDKeyboardLayout layout;
+    PDKeyboardColumn selectedColumn;
+} PDKeyboardRenderList;
+
+/// Press or release given to the button callback.
+typedef struct {
+    PDButtons button;
+    bool_t down;
+    unsigned int time;
+} PDKeyboardButtonEvent;
+
+/// Power of two: the ring indexes wrap around with a mask.
+#define kButtonEventCapacity 16
+
+#define kRecorderBufferSize 256
+
+typedef struct {
+    SDFile * _Nonnull file;
+    uint8_t buffer[kRecorderBufferSize];
+    unsigned int count;
+    unsigned int lastTime;
+} PDKeyboardRecorder;
+
+#if PDKEYBOARD_STATS
+#define kStatsFrameCount 64
+
+typedef struct {
+    float phaseMilliseconds[kKeyboardPhaseCount];
+    float frameMilliseconds;
+    uint16_t textReallocs;
+    uint16_t sampleLoads;
+    uint16_t drawCalls;
+} PDKeyboardFrameStats;
+
+typedef struct {
+    PDKeyboardFrameStats frames[kStatsFrameCount];
+    unsigned int frameIndex;
+    unsigned int frameCount;
+    PDKeyboardFrameStats current;
+    /// Elapsed time at the end of the previous phase, in seconds since the start of the frame.
+    float phaseStart;
+    /// Set when the elapsed time went back during the frame: its times are wrong and it is dropped.
+    bool_t timerWasReset;
+} PDKeyboardStatsRecorder;
+#endif
+
 typedef struct pdkeyboard {
     PDKeyboardMutableText text;
     PDKeyboardText originalText;
     bool_t okButtonPressed;
     float degreesSinceClick;
+    PDKeyboardCrankProfile crankProfile;
+    /// 360 / crankProfile.ticksPerRevolution.
+    float clickDegrees;
 
     PDKeyboardCapitalization capitalizationBehavior;
 
@@ -82,16 +229,40 @@ typedef struct pdkeyboard {
     bool_t isVisible;
     bool_t justOpened;
 
-    PDKeyboardAnimationType currentAnimationType;
-    unsigned int animationDuration;
-    unsigned int animationStartTime;
+    PDKeyboardAnimation animations[kAnimationChannelCount];
+    /// Bit i is set while animations[i] is running.
+    uint8_t runningAnimations;
 
     float refreshRate;
-    int8_t frameRateAdjustedScrollRepeatDelay;
-
-    int8_t columnJiggle;
-    int8_t rowJiggle;
-    int8_t rowShift;
+    /// Buttons, crank change and time of the current frame, read once at the start of keyboardUpdate.
+    PDKeyboardInput input;
+    /// Given by setFrameInput, used by the next keyboardUpdate instead of reading playdate->system.
+    PDKeyboardInput nextInput;
+    bool_t hasNextInput;
+    /// True during keyboardUpdate, input.time is then the current time.
+    bool_t isUpdating;
+
+    // Button callback
+    PDKeyboardInputMode inputMode;
+    PDButtonCallbackFunction * _Nullable playdateButtonCallback;
+    void * _Nullable playdateButtonCallbackUserdata;
+    int playdateButtonCallbackQueueSize;
+    bool_t buttonCallbackRegistered;
+    /// Ring written by keyboardButtonCallback only (buttonEventHead) and read by keyboardUpdate only
+    /// (buttonEventTail), events are dropped when it is full.
+    PDKeyboardButtonEvent buttonEvents[kButtonEventCapacity];
+    volatile unsigned int buttonEventHead;
+    volatile unsigned int buttonEventTail;
+    /// Events of the current frame, in order.
+    PDKeyboardButtonEvent frameButtonEvents[kButtonEventCapacity];
+    unsigned int frameButtonEventCount;
+    /// True when input was made from frameButtonEvents instead of getButtonState.
+    bool_t usesFrameButtonEvents;
+    /// Buttons held down after the last event read from the ring.
+    PDButtons eventButtons;
+    /// Time between the last two updates, at most kMaxFrameDurationMilliseconds. Duration of a frame at
+    /// refreshRate until the keyboard was updated twice.
+    unsigned int frameDurationMilliseconds;
 
     int8_t selectionY;
     struct rectangle keyboardRect;
@@ -102,34 +273,72 @@ typedef struct pdkeyboard {
     PDKeyboardCallback * _Nullable keyboardDidShowCallback;
     PDKeyboardCallback * _Nullable keyboardDidHideCallback;
     PDKeyboardCallback * _Nullable keyboardAnimatingCallback;
+    PDKeyboardCallback * _Nullable keyboardReadyCallback;
 
     void * _Nullable textChangedCallbackUserdata;
     void * _Nullable keyboardWillHideCallbackUserdata;
     void * _Nullable keyboardDidShowCallbackUserdata;
     void * _Nullable keyboardDidHideCallbackUserdata;
     void * _Nullable keyboardAnimatingCallbackUserdata;
+    void * _Nullable keyboardReadyCallbackUserdata;
 
     PDCallbackFunction * _Nullable playdateUpdate;
     void * _Nullable playdateUpdateUserdata;
 
     bool_t scrollingVertically;
-    int8_t scrollRepeatDelay;
+    unsigned int nextScrollRepeatTime;
 
-    int8_t keyRepeatDelay;
+    /// Shared by A and B.
+    unsigned int nextKeyRepeatTime;
 
     unsigned int lastKeyEnteredTime;
 
-    // Animation Variables
-    float selectionYOffset;
-    float selectionStartY;
-
     // Sounds
-    SamplePlayer * _Nullable samplePlayer;
-    AudioSample * _Nullable columnNextSound;
-    AudioSample * _Nullable columnPreviousSound;
-    AudioSample * _Nullable rowSound;
-    AudioSample * _Nullable bumpSound;
-    AudioSample * _Nullable keySound;
+    AudioSample * _Nullable samples[kSoundCount];
+    /// Players bound to their sample once, see soundFirstVoices.
+    SamplePlayer * _Nullable voices[kVoiceCount];
+    uint8_t nextVoices[kSoundCount];
+    unsigned int soundPlayTimes[kSoundCount];
+    /// Bit i is set when sound i was played at least once and soundPlayTimes[i] is valid.
+    uint8_t playedSounds;
+    PDSynth * _Nullable synths[kSoundCount];
+    PDKeyboardSoundBackend soundBackend;
+    PDKeyboardSoundResidency soundResidency;
+
+    // Dirty rect
+    struct rectangle selectionJiggle;
+    PDKeyboardLayout layout;
+    PDKeyboardLayout drawnLayout;
+    LCDRect dirtyRect;
+    bool_t dirtyRectTracking;
+    bool_t needsDisplay;
+    PDKeyboardRenderList renderList;
+
+    // Slide animation
+    PDKeyboardSlideStyle slideStyle;
+#if !PDKEYBOARD_FRAMEBUFFER
+    LCDBitmap * _Nullable keyboardImage;
+    PDKeyboardLayout keyboardImageLayout;
+    PDKeyboardColumn keyboardImageColumn;
+    bool_t keyboardImageIsValid;
+#endif
+
+    // Incremental loading
+    /// Set once the shared assets are loaded and the ready callback was called.
+    bool_t isReady;
+
+    // Idle
+    unsigned int idleFrameThreshold;
+    float idleRefreshRate;
+    unsigned int idleFrameCount;
+    bool_t idleRefreshRateApplied;
+
+    // Recording
+    PDKeyboardRecorder * _Nullable recorder;
+
+#if PDKEYBOARD_STATS
+    PDKeyboardStatsRecorder stats;
+#endif
 } PDKeyboard;
 
 static void selectColumn(PDKeyboard * _Nonnull self, PDKeyboardColumn column);
@@ -140,69 +349,234 @@ static void PDKeyboardMutableTextPush(PDKeyboardMutableText * _Nonnull self, cha
 static void PDKeyboardMutableTextEnsureCapacity(PDKeyboardMutableText * _Nonnull self, int required);
 static void PDKeyboardMutableTextGrow(PDKeyboardMutableText * _Nonnull self, int newSize);
 
-static void PDKeyboardHide(PDKeyboard * _Nonnull self);
+static void startHideAnimation(PDKeyboard * _Nonnull self);
+static void continueLoading(PDKeyboard * _Nonnull self);
+static void loadFontAndImages(void);
 
 
 #pragma mark - Constants
 
-static const float displayWidth = LCD_COLUMNS;
-static const float displayHeight = LCD_ROWS;
+static const int displayWidth = LCD_COLUMNS;
+static const int displayHeight = LCD_ROWS;
 
-static LCDFont * _Nullable keyboardFont;
-static LCDBitmap * _Nullable menuImageSpace;
-static LCDBitmap * _Nullable menuImageOK;
-static LCDBitmap * _Nullable menuImageDelete;
-static LCDBitmap * _Nullable menuImageCancel;
+static PDKEYBOARD_THREAD_LOCAL LCDFont * _Nullable keyboardFont;
+static PDKEYBOARD_THREAD_LOCAL LCDBitmap * _Nullable menuImageSpace;
+static PDKEYBOARD_THREAD_LOCAL LCDBitmap * _Nullable menuImageOK;
+static PDKEYBOARD_THREAD_LOCAL LCDBitmap * _Nullable menuImageDelete;
+static PDKEYBOARD_THREAD_LOCAL LCDBitmap * _Nullable menuImageCancel;
 
-static float fontHeight;
+static PDKEYBOARD_THREAD_LOCAL int fontHeight;
 static const char lowerColumn[] = {'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o', 'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y', 'z'};
 static const char upperColumn[] = {'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M', 'N', 'O', 'P', 'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y', 'Z'};
 static const char numbersColumn[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9', '0', '.', ',', ':', ';', '<', '=', '>', '?', '!', '\'', '"', '#', '$', '%', '&', '(', ')', '*', '+', '-', '/', '|', '\\', '[', ']', '^', '_', '`', '{', '}', '~', '@'};
 #define kMenuColumnCount 4
-static LCDBitmap * _Nullable menuColumn[kMenuColumnCount];
-
-static const void * _Nonnull columns[] = {numbersColumn, upperColumn, lowerColumn, menuColumn};
+static PDKEYBOARD_THREAD_LOCAL LCDBitmap * _Nullable menuColumn[kMenuColumnCount];
+
+// The shared assets are loaded in steps: the atlas, the font, each menu image then each
+// letter/symbol column. loadNextAsset runs one step, loadFontAndImages runs all of them.
+#define kAssetsStepAtlas 0
+#define kAssetsStepFont 1
+#define kAssetsStepMenuImages 2
+#define kAssetsStepColumns (kAssetsStepMenuImages + kMenuColumnCount)
+#define kAssetsStepCount (kAssetsStepColumns + kColumnMenu)
+/// Next step to run, kAssetsStepCount when every asset is loaded.
+static PDKEYBOARD_THREAD_LOCAL unsigned int assetsLoadStep;
+
+static const char * _Nonnull columns[] = {numbersColumn, upperColumn, lowerColumn};
 static unsigned int columnCounts[] = {sizeof(numbersColumn), sizeof(upperColumn), sizeof(lowerColumn), 4};
 
-#define rightMargin 8.0f
-#define standardColumnWidth 36.0f
-#define menuColumnWidth 50.0f
-#define leftMargin 12.0f
+#define rightMargin 8
+#define standardColumnWidth 36
+#define menuColumnWidth 50
+#define leftMargin 12
 
-static const float keyboardWidth = rightMargin + (standardColumnWidth * 3) + menuColumnWidth + leftMargin;
+static const int keyboardWidth = rightMargin + (standardColumnWidth * 3) + menuColumnWidth + leftMargin;
 
-static const float columnWidths[] = {standardColumnWidth, standardColumnWidth, standardColumnWidth, menuColumnWidth};
+static const int columnWidths[] = {standardColumnWidth, standardColumnWidth, standardColumnWidth, menuColumnWidth};
 
 #define p1 leftMargin
 #define p2 (p1 + standardColumnWidth)
 #define p3 (p2 + standardColumnWidth)
 #define p4 (p3 + standardColumnWidth)
 
-static const float columnPositions[] = {p1, p2, p3, p4};
+static const int columnPositions[] = {p1, p2, p3, p4};
 
-static const float rowHeight = 38.0f;
+static const int rowHeight = 38;
 
 // this is used for debouncing, I believe we were getting double letter entry at one point in initial wifi password setup
 static const unsigned int minKeyRepeatMilliseconds = 100;
 
+// Timers are in milliseconds so that the keyboard behaves the same at any refresh rate.
+// A selection effect is drawn by 1 frame at 30 fps and by 2 frames at 50 fps.
+#define kSelectionEffectMilliseconds 33
+#define kInitialKeyRepeatMilliseconds 300
+// the following repeat delays should be shorter
+#define kKeyRepeatMilliseconds 100
+#define kInitialScrollRepeatMilliseconds 180
+// Not a multiple of the 33 ms frames of 30 fps, which would step 2 rows at once whenever a frame lasts 34 ms.
+#define kScrollRepeatMilliseconds 40
+// Repeats caught up by a single frame, the others are dropped after a longer stall.
+#define kMaxRepeatsPerFrame 3
+// Longer frames, like the ones of an idle refresh rate, are not used to start the scroll animations.
+#define kMaxFrameDurationMilliseconds 50
+
+/// @brief Returns true when <em>now</em> reached <em>time</em>, even if the millisecond clock wrapped around.
+static bool_t isTimeReached(unsigned int now, unsigned int time) {
+    return (int) (now - time) >= 0;
+}
+
+/// @brief Returns the number of repeats due at <em>now</em> and moves <em>nextTime</em> past them by whole
+/// intervals: the time elapsed since a deadline is kept, so the repeat rate doesn't depend on the frame rate.
+static unsigned int takeRepeats(unsigned int * _Nonnull nextTime, unsigned int now, unsigned int interval) {
+    unsigned int count = 0;
+    while (count < kMaxRepeatsPerFrame && isTimeReached(now, *nextTime)) {
+        *nextTime += interval;
+        count++;
+    }
+    if (isTimeReached(now, *nextTime)) {
+        *nextTime = now + interval;
+    }
+    return count;
+}
+
+/// @brief Returns the time of the current frame during keyboardUpdate, reads the clock otherwise.
+static unsigned int getCurrentTime(PDKeyboard * _Nonnull self) {
+    return self->isUpdating ? self->input.time : playdate->system->getCurrentTimeMilliseconds();
+}
+
 static int max(int lhs, int rhs) {
     return lhs > rhs ? lhs : rhs;
 }
 
+static int min(int lhs, int rhs) {
+    return lhs < rhs ? lhs : rhs;
+}
+
+// Scroll offsets are stored in fixed point with kFixedShift fractional bits.
+#define kFixedShift 12
+
+static int intToFixed(int value) {
+    return value * (1 << kFixedShift);
+}
+
+/// @brief Converts a fixed point value to an integer, truncated toward zero like a float conversion.
+static int fixedToInt(int value) {
+    return value >= 0 ? value >> kFixedShift : -(-value >> kFixedShift);
+}
+
+#pragma mark - Stats
+
+#if PDKEYBOARD_STATS
+// The elapsed time is reset at the start of each frame: a float counting seconds since launch
+// would lose the sub-millisecond precision after a few minutes. A frame where the game reset it
+// again from its playdateUpdate is dropped. Counts made outside of a frame are added to the next frame.
+
+static void statsBeginFrame(PDKeyboard * _Nonnull self) {
+    playdate->system->resetElapsedTime();
+    self->stats.phaseStart = 0.0f;
+    self->stats.timerWasReset = false;
+}
+
+static void statsEndPhase(PDKeyboard * _Nonnull self, PDKeyboardPhase phase) {
+    PDKeyboardStatsRecorder *stats = &self->stats;
+    const float now = playdate->system->getElapsedTime();
+    if (now < stats->phaseStart) {
+        stats->timerWasReset = true;
+    }
+    stats->current.phaseMilliseconds[phase] += (now - stats->phaseStart) * 1000.0f;
+    stats->phaseStart = now;
+}
+
+static void statsEndFrame(PDKeyboard * _Nonnull self) {
+    PDKeyboardStatsRecorder *stats = &self->stats;
+    stats->current.textReallocs += self->text.reallocCount;
+    self->text.reallocCount = 0;
+    if (stats->timerWasReset) {
+        stats->current = (PDKeyboardFrameStats) {};
+        return;
+    }
+    stats->current.frameMilliseconds = stats->phaseStart * 1000.0f;
+
+    stats->frames[stats->frameIndex] = stats->current;
+    stats->frameIndex = (stats->frameIndex + 1) % kStatsFrameCount;
+    if (stats->frameCount < kStatsFrameCount) {
+        stats->frameCount++;
+    }
+    stats->current = (PDKeyboardFrameStats) {};
+}
+
+#define statsCountTextRealloc(self) ((self)->stats.current.textReallocs++)
+#define statsCountSampleLoad(self) ((self)->stats.current.sampleLoads++)
+#define statsCountDrawCalls(self, count) ((self)->stats.current.drawCalls += (count))
+
+static void statValueAdd(PDKeyboardStatValue * _Nonnull self, float value, bool_t first) {
+    if (first || value < self->min) {
+        self->min = value;
+    }
+    if (first || value > self->max) {
+        self->max = value;
+    }
+    self->average += value;
+}
+#else
+#define statsBeginFrame(self)
+#define statsEndPhase(self, phase)
+#define statsEndFrame(self)
+#define statsCountTextRealloc(self)
+#define statsCountSampleLoad(self)
+#define statsCountDrawCalls(self, count) ((void) (count))
+#endif
+
 #pragma mark - Keyboard Input Handler
 
-static const float clickDegrees = 360.0f / 15.0f;
+static const PDKeyboardCrankProfile defaultCrankProfile = {
+    .sensitivity = 1.0f,
+    .ticksPerRevolution = 15,
+    .maxClicksPerFrame = sizeof(numbersColumn),
+};
+
+// Acceleration factor of the crank, 1 / (0.2 + 1.04^(20 - |change|)), sampled every kCrankAccelerationStep
+// degrees. Changes past the last sample use it, the factor is within 0.001 of its limit of 5.
+#define kCrankAccelerationStep 2
+#define kCrankAccelerationCount 161
+static PDKEYBOARD_THREAD_LOCAL float crankAccelerations[kCrankAccelerationCount];
+static PDKEYBOARD_THREAD_LOCAL bool_t crankAccelerationsAreValid;
+
+static void buildCrankAccelerationTable(void) {
+    if (crankAccelerationsAreValid) {
+        return;
+    }
+    for (unsigned int index = 0; index < kCrankAccelerationCount; index++) {
+        const float change = index * kCrankAccelerationStep;
+        crankAccelerations[index] = 1.0f / (0.2f + powf(1.04f, -change + 20.0f));
+    }
+    crankAccelerationsAreValid = true;
+}
+
+/// @brief Returns the acceleration factor of <em>change</em>, interpolated between the samples of crankAccelerations.
+static float getCrankAcceleration(float change) {
+    const float position = fabsf(change) / kCrankAccelerationStep;
+    if (!(position < kCrankAccelerationCount - 1)) {
+        return crankAccelerations[kCrankAccelerationCount - 1];
+    }
+    const unsigned int index = position;
+    const float lower = crankAccelerations[index];
+    return lower + (crankAccelerations[index + 1] - lower) * (position - index);
+}
 
 static void keyboardInputCranked(PDKeyboard * _Nonnull self, float change) {
-    const float acceleratedChange = change * (1.0f / (0.2f + powf(1.04f, -fabsf(change) + 20.0f)));
+    const float acceleratedChange = change * getCrankAcceleration(change) * self->crankProfile.sensitivity;
     const float degreesSinceClick = self->degreesSinceClick + acceleratedChange;
+    const float clickDegrees = self->clickDegrees;
+    // Clamped before the conversion: a fast spin must not overflow the selection arithmetic.
+    const float maxClicks = self->crankProfile.maxClicksPerFrame;
 
     if (degreesSinceClick > clickDegrees) {
-        const int clickCount = floorf(degreesSinceClick / clickDegrees);
+        const int clickCount = fminf(floorf(degreesSinceClick / clickDegrees), maxClicks);
         self->degreesSinceClick = 0.0f;
         moveSelectionDown(self, clickCount, false);
     } else if (degreesSinceClick < -clickDegrees) {
-        const int clickCount = ceilf(-degreesSinceClick / clickDegrees);
+        const int clickCount = fminf(ceilf(-degreesSinceClick / clickDegrees), maxClicks);
         self->degreesSinceClick = 0.0f;
         moveSelectionUp(self, clickCount, false);
     } else {
@@ -210,13 +584,67 @@ static void keyboardInputCranked(PDKeyboard * _Nonnull self, float change) {
     }
 }
 
+/// @brief Button callback registered in kInputModeButtonCallback. Queues the event for the next keyboardUpdate,
+/// then gives it to the button callback of the game.
+static int keyboardButtonCallback(PDButtons button, int down, uint32_t when, void * _Nullable userdata) {
+    PDKeyboard *self = userdata;
+    const unsigned int head = self->buttonEventHead;
+    if (head - self->buttonEventTail < kButtonEventCapacity) {
+        self->buttonEvents[head & (kButtonEventCapacity - 1)] = (PDKeyboardButtonEvent) {
+            .button = button,
+            .down = down != 0,
+            .time = when,
+        };
+        // Published once the event is written.
+        self->buttonEventHead = head + 1;
+    }
+    if (self->playdateButtonCallback) {
+        return self->playdateButtonCallback(button, down, when, self->playdateButtonCallbackUserdata);
+    }
+    return 0;
+}
 
-#pragma mark - Easing Functions
+static void registerButtonCallback(PDKeyboard * _Nonnull self) {
+    if (self->buttonCallbackRegistered) {
+        return;
+    }
+    // Buttons already held down are released by an event later.
+    playdate->system->getButtonState(&self->eventButtons, NULL, NULL);
+    self->buttonEventTail = self->buttonEventHead;
+    playdate->system->setButtonCallback(keyboardButtonCallback, self, kButtonEventCapacity);
+    self->buttonCallbackRegistered = true;
+}
 
-static float linearEase(float t, float b, float c, float d) {
-    return c * t / d + b;
+/// @brief Registers the button callback of the game again, or none.
+static void restoreButtonCallback(PDKeyboard * _Nonnull self) {
+    if (!self->buttonCallbackRegistered) {
+        return;
+    }
+    playdate->system->setButtonCallback(self->playdateButtonCallback, self->playdateButtonCallbackUserdata, self->playdateButtonCallbackQueueSize);
+    self->buttonCallbackRegistered = false;
 }
 
+/// @brief Moves the events queued since the last frame to frameButtonEvents.
+static void drainButtonEvents(PDKeyboard * _Nonnull self) {
+    const unsigned int head = self->buttonEventHead;
+    unsigned int tail = self->buttonEventTail;
+    unsigned int count = 0;
+    for (; tail != head; tail++) {
+        const PDKeyboardButtonEvent event = self->buttonEvents[tail & (kButtonEventCapacity - 1)];
+        if (event.down) {
+            self->eventButtons |= event.button;
+        } else {
+            self->eventButtons &= ~event.button;
+        }
+        self->frameButtonEvents[count++] = event;
+    }
+    self->buttonEventTail = tail;
+    self->frameButtonEventCount = count;
+}
+
+
+#pragma mark - Easing Functions
+
 static float outBackEase(float t, float b, float c, float d, float s) {
     if (s == 0) {
         s = 1.70158f;
@@ -225,13 +653,118 @@ static float outBackEase(float t, float b, float c, float d, float s) {
     return floorf(c * (t * t * ((s + 1) * t + s) + 1) + b);
 }
 
+/// @brief Returns b + c * t / d in fixed point, <em>b</em> and <em>c</em> being in fixed point.
+static int linearEaseFixed(unsigned int t, int b, int c, unsigned int d) {
+    // Rounded to the nearest value, like the float version.
+    const int64_t product = (int64_t) c * t;
+    const int64_t duration = d;
+    return (int) ((product >= 0 ? product + duration / 2 : product - duration / 2) / duration) + b;
+}
+
+#define kSlideAnimationDuration 220
+/// Left of the keyboard for each millisecond of the show and hide slides. Built once from outBackEase so that
+/// updateAnimations only reads a value.
+static PDKEYBOARD_THREAD_LOCAL int16_t showSlideLefts[kSlideAnimationDuration];
+static PDKEYBOARD_THREAD_LOCAL int16_t hideSlideLefts[kSlideAnimationDuration];
+static PDKEYBOARD_THREAD_LOCAL bool_t slideLeftsAreValid;
+
+static void buildSlideTables(void) {
+    if (slideLeftsAreValid) {
+        return;
+    }
+    for (unsigned int t = 0; t < kSlideAnimationDuration; t++) {
+        showSlideLefts[t] = outBackEase(t, displayWidth, - keyboardWidth, kSlideAnimationDuration, 1);
+        hideSlideLefts[t] = outBackEase(t, displayWidth - keyboardWidth, keyboardWidth, kSlideAnimationDuration, 1);
+    }
+    slideLeftsAreValid = true;
+}
+
 #pragma mark - Sounds
 
-static const char kSoundColumnMoveNext[] = "CoreLibs/assets/sfx/selection";
-static const char kSoundColumnMovePrevious[] = "CoreLibs/assets/sfx/selection-reverse";
-static const char kSoundRowMove[] = "CoreLibs/assets/sfx/click";
-static const char kSoundBump[] = "CoreLibs/assets/sfx/denial";
-static const char kSoundKeyPress[] = "CoreLibs/assets/sfx/key";
+static const char * _Nonnull const soundPaths[kSoundCount] = {
+    [kSoundColumnMoveNext] = "CoreLibs/assets/sfx/selection",
+    [kSoundColumnMovePrevious] = "CoreLibs/assets/sfx/selection-reverse",
+    [kSoundRowMove] = "CoreLibs/assets/sfx/click",
+    [kSoundBump] = "CoreLibs/assets/sfx/denial",
+    [kSoundKeyPress] = "CoreLibs/assets/sfx/key",
+};
+
+/// Index of the first voice of each sound in PDKeyboard.voices.
+static const uint8_t soundFirstVoices[kSoundCount] = {
+    [kSoundColumnMoveNext] = 0,
+    [kSoundColumnMovePrevious] = 1,
+    [kSoundRowMove] = 2,
+    [kSoundBump] = 2 + kRowMoveVoiceCount,
+    [kSoundKeyPress] = 3 + kRowMoveVoiceCount,
+};
+
+static const uint8_t soundVoiceCounts[kSoundCount] = {
+    [kSoundColumnMoveNext] = 1,
+    [kSoundColumnMovePrevious] = 1,
+    [kSoundRowMove] = kRowMoveVoiceCount,
+    [kSoundBump] = 1,
+    [kSoundKeyPress] = 1,
+};
+
+/// Minimum time between two plays of the same sound. Plays coming sooner would not be heard and are dropped.
+static const unsigned int soundRetriggerMilliseconds[kSoundCount] = {
+    [kSoundColumnMoveNext] = 30,
+    [kSoundColumnMovePrevious] = 30,
+    [kSoundRowMove] = 30,
+    [kSoundBump] = 100,
+    [kSoundKeyPress] = 30,
+};
+
+/// Note played by a synth in place of a sample.
+typedef struct {
+    SoundWaveform waveform;
+    /// Frequency in Hz.
+    float frequency;
+    /// Duration of the note in seconds, the release starts after it.
+    float length;
+    float attackTime;
+    float decayTime;
+    float sustainLevel;
+    float releaseTime;
+    float volume;
+} PDKeyboardSynthSound;
+
+static const PDKeyboardSynthSound synthSounds[kSoundCount] = {
+    // Short rising and falling blips.
+    [kSoundColumnMoveNext] = {kWaveformTriangle, 1318.5f, 0.03f, 0.0f, 0.03f, 0.0f, 0.02f, 0.5f},
+    [kSoundColumnMovePrevious] = {kWaveformTriangle, 987.8f, 0.03f, 0.0f, 0.03f, 0.0f, 0.02f, 0.5f},
+    // A few milliseconds of square wave, shorter than the retrigger interval of the crank.
+    [kSoundRowMove] = {kWaveformSquare, 2093.0f, 0.005f, 0.0f, 0.005f, 0.0f, 0.005f, 0.25f},
+    [kSoundBump] = {kWaveformSquare, 110.0f, 0.12f, 0.0f, 0.1f, 0.3f, 0.04f, 0.4f},
+    [kSoundKeyPress] = {kWaveformNoise, 4000.0f, 0.015f, 0.0f, 0.015f, 0.0f, 0.01f, 0.35f},
+};
+
+/// @brief Creates the synth of the given sound and sets its waveform, envelope and volume once.
+static void loadSynth(PDKeyboard * _Nonnull self, PDKeyboardSound sound) {
+    if (self->synths[sound] != NULL) {
+        return;
+    }
+    const struct playdate_sound_synth *synthApi = playdate->sound->synth;
+    const PDKeyboardSynthSound *synthSound = &synthSounds[sound];
+    PDSynth *synth = synthApi->newSynth();
+    synthApi->setWaveform(synth, synthSound->waveform);
+    synthApi->setAttackTime(synth, synthSound->attackTime);
+    synthApi->setDecayTime(synth, synthSound->decayTime);
+    synthApi->setSustainLevel(synth, synthSound->sustainLevel);
+    synthApi->setReleaseTime(synth, synthSound->releaseTime);
+    synthApi->setVolume(synth, synthSound->volume, synthSound->volume);
+    self->synths[sound] = synth;
+}
+
+/// Sample data read from the keyboard atlas, shared by keyboards like the font and images.
+typedef struct {
+    uint8_t * _Nullable data;
+    SoundFormat format;
+    uint32_t sampleRate;
+    int byteCount;
+} PDKeyboardAtlasSound;
+
+static PDKEYBOARD_THREAD_LOCAL PDKeyboardAtlasSound atlasSounds[kSoundCount];
 
 static AudioSample * _Nonnull newSampleOrError(const char * _Nonnull path) {
     AudioSample *sample = playdate->sound->sample->load(path);
@@ -241,255 +774,1123 @@ static AudioSample * _Nonnull newSampleOrError(const char * _Nonnull path) {
     return sample;
 }
 
-static void playSound(SamplePlayer * _Nonnull * _Nullable samplePlayer, AudioSample * _Nonnull * _Nullable sample, const char * _Nonnull path) {
-    AudioSample *theSample = *sample;
-    if (theSample == NULL) {
-        theSample = newSampleOrError(path);
-        *sample = theSample;
+/// @brief Loads the sample of the given sound and binds it to its voices, or creates its synth.
+static void loadSound(PDKeyboard * _Nonnull self, PDKeyboardSound sound) {
+    if (self->soundBackend == kSoundBackendSynth) {
+        loadSynth(self, sound);
+        return;
+    }
+    if (self->samples[sound] != NULL) {
+        return;
+    }
+    const PDKeyboardAtlasSound *atlasSound = &atlasSounds[sound];
+    AudioSample *sample = atlasSound->data
+        ? playdate->sound->sample->newSampleFromData(atlasSound->data, atlasSound->format, atlasSound->sampleRate, atlasSound->byteCount, false)
+        : newSampleOrError(soundPaths[sound]);
+    self->samples[sound] = sample;
+    statsCountSampleLoad(self);
+
+    const unsigned int firstVoice = soundFirstVoices[sound];
+    for (unsigned int voice = firstVoice; voice < firstVoice + soundVoiceCounts[sound]; voice++) {
+        if (self->voices[voice] == NULL) {
+            self->voices[voice] = playdate->sound->sampleplayer->newPlayer();
+        }
+        playdate->sound->sampleplayer->setSample(self->voices[voice], sample);
     }
-    SamplePlayer *theSamplePlayer = *samplePlayer;
-    if (theSamplePlayer == NULL) {
-        theSamplePlayer = playdate->sound->sampleplayer->newPlayer();
-        *samplePlayer = theSamplePlayer;
+}
+
+/// @brief Plays the given sound on its next voice, stopping the oldest play of the sound when all its voices are busy.
+static void playSound(PDKeyboard * _Nonnull self, PDKeyboardSound sound) {
+    const unsigned int now = getCurrentTime(self);
+    const uint8_t soundBit = 1 << sound;
+    if ((self->playedSounds & soundBit) && now - self->soundPlayTimes[sound] < soundRetriggerMilliseconds[sound]) {
+        return;
+    }
+    self->playedSounds |= soundBit;
+    self->soundPlayTimes[sound] = now;
+
+    loadSound(self, sound);
+    if (self->soundBackend == kSoundBackendSynth) {
+        const PDKeyboardSynthSound *synthSound = &synthSounds[sound];
+        playdate->sound->synth->playNote(self->synths[sound], synthSound->frequency, 1.0f, synthSound->length, 0);
+        return;
+    }
+    const uint8_t voiceIndex = self->nextVoices[sound];
+    self->nextVoices[sound] = (voiceIndex + 1) % soundVoiceCounts[sound];
+    playdate->sound->sampleplayer->play(self->voices[soundFirstVoices[sound] + voiceIndex], 1, 1.0f);
+}
+
+/// @brief Loads every sound not loaded yet, so that no file is read while handling input.
+static void loadSounds(PDKeyboard * _Nonnull self) {
+    for (unsigned int sound = 0; sound < kSoundCount; sound++) {
+        loadSound(self, sound);
     }
-    playdate->sound->sampleplayer->setSample(theSamplePlayer, theSample);
-    playdate->sound->sampleplayer->play(theSamplePlayer, 1, 1.0f);
 }
 
 static void freeSounds(PDKeyboard * _Nonnull self) {
-    if (self->samplePlayer) {
-        playdate->sound->sampleplayer->freePlayer(self->samplePlayer);
-        self->samplePlayer = NULL;
+    for (unsigned int voice = 0; voice < kVoiceCount; voice++) {
+        if (self->voices[voice]) {
+            playdate->sound->sampleplayer->freePlayer(self->voices[voice]);
+            self->voices[voice] = NULL;
+        }
+    }
+    for (unsigned int sound = 0; sound < kSoundCount; sound++) {
+        if (self->samples[sound]) {
+            playdate->sound->sample->freeSample(self->samples[sound]);
+            self->samples[sound] = NULL;
+        }
+        if (self->synths[sound]) {
+            playdate->sound->synth->freeSynth(self->synths[sound]);
+            self->synths[sound] = NULL;
+        }
+        self->nextVoices[sound] = 0;
+    }
+}
+
+#pragma mark - Frame buffer
+
+#if PDKEYBOARD_FRAMEBUFFER
+#define kMaskShiftCount 8
+
+/// Black pixels of a glyph or menu image, pre-shifted for each of the 8 possible x alignments
+/// inside a frame buffer byte. Rows are padded to 32-bit words, only the <em>rowCount</em> rows
+/// starting at <em>top</em> contain black pixels.
+typedef struct {
+    uint8_t * _Nullable data;
+    int width;
+    int height;
+    int top;
+    int rowCount;
+    int rowbytes;
+} PDKeyboardMask;
+
+static PDKEYBOARD_THREAD_LOCAL uint8_t * _Nullable frame;
+static PDKEYBOARD_THREAD_LOCAL int frameFirstRow;
+static PDKEYBOARD_THREAD_LOCAL int frameLastRow;
+#endif
+
+/// Area where the keyboard is allowed to draw during the current frame.
+static PDKEYBOARD_THREAD_LOCAL LCDRect drawingClip;
+
+#if PDKEYBOARD_FRAMEBUFFER
+
+static bool_t isBlackPixel(const uint8_t * _Nonnull data, const uint8_t * _Nullable mask, int rowbytes, int x, int y) {
+    const int index = y * rowbytes + (x >> 3);
+    const uint8_t bit = 0x80 >> (x & 7);
+    return !(data[index] & bit) && (mask == NULL || (mask[index] & bit));
+}
+
+static void initMask(PDKeyboardMask * _Nonnull self, LCDBitmap * _Nonnull bitmap) {
+    int width, height, rowbytes;
+    uint8_t *mask, *data;
+    playdate->graphics->getBitmapData(bitmap, &width, &height, &rowbytes, &mask, &data);
+
+    int top = height;
+    int bottom = 0;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            if (isBlackPixel(data, mask, rowbytes, x, y)) {
+                top = min(top, y);
+                bottom = y + 1;
+                break;
+            }
+        }
     }
-    if (self->columnNextSound) {
-        playdate->sound->sample->freeSample(self->columnNextSound);
-        self->columnNextSound = NULL;
+    const int rowCount = max(bottom - top, 0);
+    const int maskRowbytes = ((width + kMaskShiftCount - 1 + 31) / 32) * 4;
+    *self = (PDKeyboardMask) {
+        .width = width,
+        .height = height,
+        .top = top,
+        .rowCount = rowCount,
+        .rowbytes = maskRowbytes,
+    };
+    if (rowCount == 0) {
+        return;
     }
-    if (self->columnPreviousSound) {
-        playdate->sound->sample->freeSample(self->columnPreviousSound);
-        self->columnPreviousSound = NULL;
+
+    const size_t size = kMaskShiftCount * rowCount * maskRowbytes;
+    self->data = playdate->system->realloc(NULL, size);
+    memset(self->data, 0, size);
+    for (int shift = 0; shift < kMaskShiftCount; shift++) {
+        for (int y = 0; y < rowCount; y++) {
+            uint8_t *row = self->data + (shift * rowCount + y) * maskRowbytes;
+            for (int x = 0; x < width; x++) {
+                if (isBlackPixel(data, mask, rowbytes, x, top + y)) {
+                    row[(x + shift) >> 3] |= 0x80 >> ((x + shift) & 7);
+                }
+            }
+        }
     }
-    if (self->rowSound) {
-        playdate->sound->sample->freeSample(self->rowSound);
-        self->rowSound = NULL;
+}
+
+static void freeMask(PDKeyboardMask * _Nonnull self) {
+    if (self->data) {
+        playdate->system->realloc(self->data, 0);
     }
-    if (self->bumpSound) {
-        playdate->sound->sample->freeSample(self->bumpSound);
-        self->bumpSound = NULL;
+    *self = (PDKeyboardMask) {};
+}
+
+static void frameMarkRows(int firstRow, int lastRow) {
+    frameFirstRow = min(frameFirstRow, firstRow);
+    frameLastRow = max(frameLastRow, lastRow);
+}
+
+/// @brief Fills a rectangle of the frame buffer in black or white, like kDrawModeCopy.
+static void frameFillRect(int x, int y, int width, int height, LCDColor color) {
+    if (width < 0) {
+        x += width;
+        width = -width;
+    }
+    if (height < 0) {
+        y += height;
+        height = -height;
+    }
+    const int left = max(x, drawingClip.left);
+    const int right = min(x + width, drawingClip.right);
+    const int top = max(y, drawingClip.top);
+    const int bottom = min(y + height, drawingClip.bottom);
+    if (left >= right || top >= bottom) {
+        return;
     }
-    if (self->keySound) {
-        playdate->sound->sample->freeSample(self->keySound);
-        self->keySound = NULL;
+    const int firstByte = left >> 3;
+    const int lastByte = (right - 1) >> 3;
+    uint8_t firstBits = 0xFF >> (left & 7);
+    const uint8_t lastBits = 0xFF << (7 - ((right - 1) & 7));
+    if (firstByte == lastByte) {
+        firstBits &= lastBits;
+    }
+    const uint8_t fill = color == kColorWhite ? 0xFF : 0x00;
+
+    uint8_t *target = frame + top * LCD_ROWSIZE;
+    for (int row = top; row < bottom; row++) {
+        target[firstByte] = (target[firstByte] & ~firstBits) | (fill & firstBits);
+        if (lastByte > firstByte) {
+            memset(target + firstByte + 1, fill, lastByte - firstByte - 1);
+            target[lastByte] = (target[lastByte] & ~lastBits) | (fill & lastBits);
+        }
+        target += LCD_ROWSIZE;
     }
+    frameMarkRows(top, bottom - 1);
 }
 
+/// @brief Inverts the frame buffer pixels under the black pixels of <em>mask</em>, like drawing
+/// its image with kDrawModeNXOR. Only the rows are clipped to the drawing clip, callers skip
+/// the masks outside of it horizontally.
+static void frameDrawMask(const PDKeyboardMask * _Nonnull mask, int x, int y) {
+    const int shift = x & 7;
+    const int byteX = (x - shift) / 8;
+    const int rowbytes = mask->rowbytes;
+    const int firstRow = max(y + mask->top, drawingClip.top);
+    const int lastRow = min(y + mask->top + mask->rowCount, drawingClip.bottom);
+    if (firstRow >= lastRow || byteX >= LCD_ROWSIZE || byteX + rowbytes <= 0) {
+        return;
+    }
+    const uint8_t *source = mask->data + (shift * mask->rowCount + firstRow - y - mask->top) * rowbytes;
+    uint8_t *target = frame + firstRow * LCD_ROWSIZE + byteX;
+
+    if (byteX >= 0 && byteX + rowbytes <= LCD_ROWSIZE) {
+        // Target words are not aligned: memcpy compiles to single unaligned loads/stores on the Cortex-M7.
+        for (int row = firstRow; row < lastRow; row++) {
+            for (int byte = 0; byte < rowbytes; byte += 4) {
+                uint32_t bits;
+                uint32_t pixels;
+                memcpy(&bits, source + byte, sizeof(bits));
+                memcpy(&pixels, target + byte, sizeof(pixels));
+                pixels ^= bits;
+                memcpy(target + byte, &pixels, sizeof(pixels));
+            }
+            source += rowbytes;
+            target += LCD_ROWSIZE;
+        }
+    } else {
+        const int firstByte = max(-byteX, 0);
+        const int lastByte = min(LCD_ROWSIZE - byteX, rowbytes);
+        for (int row = firstRow; row < lastRow; row++) {
+            for (int byte = firstByte; byte < lastByte; byte++) {
+                target[byte] ^= source[byte];
+            }
+            source += rowbytes;
+            target += LCD_ROWSIZE;
+        }
+    }
+    frameMarkRows(firstRow, lastRow - 1);
+}
+#endif
+
 #pragma mark - Graphics
 
+static const LCDRect screenRect = {
+    .left = 0,
+    .right = LCD_COLUMNS,
+    .top = 0,
+    .bottom = LCD_ROWS,
+};
+
+#if !PDKEYBOARD_FRAMEBUFFER
+static bool_t isClipping(void) {
+    return drawingClip.left != screenRect.left || drawingClip.right != screenRect.right
+        || drawingClip.top != screenRect.top || drawingClip.bottom != screenRect.bottom;
+}
+
+/// @brief Sets the clip rect, restricted to the drawing clip.
+/// @return Number of draw calls.
+static int setClipRect(int x, int y, int width, int height) {
+    const int left = max(x, drawingClip.left);
+    const int top = max(y, drawingClip.top);
+    playdate->graphics->setClipRect(left, top, max(min(x + width, drawingClip.right) - left, 0), max(min(y + height, drawingClip.bottom) - top, 0));
+    return 1;
+}
+
+/// @brief Restores the drawing clip after a call to setClipRect.
+/// @return Number of draw calls.
+static int resetClipRect(void) {
+    if (isClipping()) {
+        return setClipRect(drawingClip.left, drawingClip.top, drawingClip.right - drawingClip.left, drawingClip.bottom - drawingClip.top);
+    }
+    playdate->graphics->clearClipRect();
+    return 1;
+}
+#endif
+
+/// @brief Restricts the drawing to <em>clip</em> and prepares the frame buffer when drawing directly into it.
+/// @param clip Area to draw or <code>NULL</code> to draw on the whole screen.
+/// @return Number of draw calls.
+static int beginDrawing(const LCDRect * _Nullable clip) {
+    drawingClip = clip ? *clip : screenRect;
+#if PDKEYBOARD_FRAMEBUFFER
+    frame = playdate->graphics->getFrame();
+    frameFirstRow = LCD_ROWS;
+    frameLastRow = -1;
+    return 1;
+#else
+    return clip ? resetClipRect() : 0;
+#endif
+}
+
+/// @brief Removes the drawing clip and marks the rows written to the frame buffer as updated.
+/// @return Number of draw calls.
+static int endDrawing(void) {
+#if PDKEYBOARD_FRAMEBUFFER
+    if (frameFirstRow <= frameLastRow) {
+        playdate->graphics->markUpdatedRows(frameFirstRow, frameLastRow);
+        return 1;
+    }
+    return 0;
+#else
+    if (isClipping()) {
+        drawingClip = screenRect;
+        playdate->graphics->clearClipRect();
+        return 1;
+    }
+    return 0;
+#endif
+}
+
+static void setDrawMode(LCDBitmapDrawMode drawMode) {
+#if !PDKEYBOARD_FRAMEBUFFER
+    playdate->graphics->setDrawMode(drawMode);
+#endif
+}
+
+/// @brief Fill a rectangle with the copy draw mode.
+/// @return Number of draw calls.
+static int fillRect(int x, int y, int width, int height, LCDColor color) {
+#if PDKEYBOARD_FRAMEBUFFER
+    if (color == kColorBlack || color == kColorWhite) {
+        frameFillRect(x, y, width, height, color);
+        return 0;
+    }
+#endif
+    playdate->graphics->fillRect(x, y, width, height, color);
+    return 1;
+}
+
+/// @brief Draw a 1 pixel high line from <em>x1</em> to <em>x2</em> included.
+/// @return Number of draw calls.
+static int drawHorizontalLine(int x1, int x2, int y, LCDColor color) {
+#if PDKEYBOARD_FRAMEBUFFER
+    if (color == kColorBlack || color == kColorWhite) {
+        frameFillRect(min(x1, x2), y, max(x1, x2) - min(x1, x2) + 1, 1, color);
+        return 0;
+    }
+#endif
+    playdate->graphics->drawLine(x1, y, x2, y, 1, color);
+    return 1;
+}
+
+#if !PDKEYBOARD_FRAMEBUFFER
 /// @brief Draw a rounded rect with a radius of 2.
 /// @param rectangle Rectangle to draw.
-static void fillRoundRect(struct rectangle rectangle, LCDColor color) {
+/// @return Number of draw calls.
+static int fillRoundRect(struct rectangle rectangle, LCDColor color) {
     if (rectangle.size.width < 4 || rectangle.size.height < 4) {
-        playdate->graphics->fillRect(rectangle.origin.x, rectangle.origin.y, rectangle.size.width, rectangle.size.height, color);
-        return;
-    }
-    playdate->graphics->drawLine(rectangle.origin.x + 2, rectangle.origin.y,
-                                 rectangle.origin.x + rectangle.size.width - 3, rectangle.origin.y,
-                                 1, color);
-    playdate->graphics->drawLine(rectangle.origin.x + 1, rectangle.origin.y + 1,
-                                 rectangle.origin.x + rectangle.size.width - 2, rectangle.origin.y + 1,
-                                 1, color);
-    playdate->graphics->fillRect(rectangle.origin.x, rectangle.origin.y + 2, rectangle.size.width, rectangle.size.height - 4, color);
-    playdate->graphics->drawLine(rectangle.origin.x + 1, rectangle.origin.y + rectangle.size.height - 2,
-                                 rectangle.origin.x + rectangle.size.width - 2, rectangle.origin.y + rectangle.size.height - 2,
-                                 1, color);
-    playdate->graphics->drawLine(rectangle.origin.x + 2, rectangle.origin.y + rectangle.size.height - 1,
-                                 rectangle.origin.x + rectangle.size.width - 3, rectangle.origin.y + rectangle.size.height - 1,
-                                 1, color);
+        return fillRect(rectangle.origin.x, rectangle.origin.y, rectangle.size.width, rectangle.size.height, color);
+    }
+    int drawCalls = drawHorizontalLine(rectangle.origin.x + 2, rectangle.origin.x + rectangle.size.width - 3, rectangle.origin.y, color);
+    drawCalls += drawHorizontalLine(rectangle.origin.x + 1, rectangle.origin.x + rectangle.size.width - 2, rectangle.origin.y + 1, color);
+    drawCalls += fillRect(rectangle.origin.x, rectangle.origin.y + 2, rectangle.size.width, rectangle.size.height - 4, color);
+    drawCalls += drawHorizontalLine(rectangle.origin.x + 1, rectangle.origin.x + rectangle.size.width - 2, rectangle.origin.y + rectangle.size.height - 2, color);
+    drawCalls += drawHorizontalLine(rectangle.origin.x + 2, rectangle.origin.x + rectangle.size.width - 3, rectangle.origin.y + rectangle.size.height - 1, color);
+    return drawCalls;
+}
+#endif
+
+#if PDKEYBOARD_FRAMEBUFFER
+static PDKEYBOARD_THREAD_LOCAL PDKeyboardMask menuMasks[kMenuColumnCount];
+#else
+static PDKEYBOARD_THREAD_LOCAL struct int_size menuImageSizes[kMenuColumnCount];
+#endif
+
+static struct int_size getMenuImageSize(unsigned int index) {
+#if PDKEYBOARD_FRAMEBUFFER
+    return (struct int_size) {
+        .width = menuMasks[index].width,
+        .height = menuMasks[index].height,
+    };
+#else
+    return menuImageSizes[index];
+#endif
 }
 
-#pragma mark - Draw
-
-static bool_t isShowOrHideAnimation(PDKeyboardAnimationType animationType) {
-    return animationType == kAnimationTypeKeyboardShow || animationType == kAnimationTypeKeyboardHide;
+/// @brief Draws the image of a menu option with its top left corner at (<em>x</em>, <em>y</em>) with the NXOR draw mode.
+/// @return Number of draw calls.
+static int drawMenuImage(unsigned int index, int x, int y) {
+    if (assetsLoadStep <= kAssetsStepMenuImages + index) {
+        // Not loaded yet.
+        return 0;
+    }
+#if PDKEYBOARD_FRAMEBUFFER
+    frameDrawMask(&menuMasks[index], x, y);
+    return 0;
+#else
+    playdate->graphics->drawBitmap(menuColumn[index], x, y, kBitmapUnflipped);
+    return 1;
+#endif
 }
 
-static void drawKeyboard(PDKeyboard * _Nonnull self) {
-    // playdate->graphics->pushContext();
-    const struct playdate_graphics gfx = *playdate->graphics;
+#pragma mark - Columns
 
-    const PDKeyboardAnimationType currentAnimationType = self->currentAnimationType;
-    const bool_t animating = isShowOrHideAnimation(currentAnimationType);
+// Letter/symbol columns are laid out once, one glyph every rowHeight pixels. The first
+// kColumnWrapRowCount glyphs are repeated at the end so that the visible rows are always
+// contiguous, whatever the selected glyph is. Rows are either pre-rendered into a bitmap
+// or kept as a text with one glyph per line. The frame buffer renderer draws each glyph
+// from its own mask instead.
+#define kColumnWrapRowCount 8
 
-    const struct rectangle keyboardRect = self->keyboardRect;
-    int columnOffsets[kColumnCount];
+/// Whether the columns are built from glyph images, that can be read from the keyboard atlas instead of the font.
+#define kColumnsUseGlyphImages (PDKEYBOARD_FRAMEBUFFER || PDKEYBOARD_COLUMN_STRIPS)
 
-    if (!animating) {
-        for (unsigned int index = 0; index < kColumnCount; index++) {
-            columnOffsets[index] = keyboardRect.origin.x + columnPositions[index];
+#if kColumnsUseGlyphImages
+#define kAtlasGlyphCapacity 128
+
+/// Glyphs read from the keyboard atlas, indexed by character. Only loaded while the columns are built.
+static PDKEYBOARD_THREAD_LOCAL LCDBitmap * _Nullable atlasGlyphImages[kAtlasGlyphCapacity];
+static PDKEYBOARD_THREAD_LOCAL uint8_t atlasGlyphAdvances[kAtlasGlyphCapacity];
+static PDKEYBOARD_THREAD_LOCAL int atlasFontHeight;
+
+/// @brief Returns true when the atlas has a glyph for every character of the columns.
+static bool_t hasAtlasGlyphs(void) {
+    for (unsigned int column = 0; column < kColumnMenu; column++) {
+        for (unsigned int index = 0; index < columnCounts[column]; index++) {
+            if (atlasGlyphImages[(uint8_t) columns[column][index]] == NULL) {
+                return false;
+            }
         }
+    }
+    return true;
+}
+
+static void freeAtlasGlyphs(void) {
+    for (unsigned int index = 0; index < kAtlasGlyphCapacity; index++) {
+        if (atlasGlyphImages[index]) {
+            playdate->graphics->freeBitmap(atlasGlyphImages[index]);
+            atlasGlyphImages[index] = NULL;
+        }
+    }
+}
+
+static int getGlyphWidth(char glyph) {
+    if (keyboardFont == NULL) {
+        return atlasGlyphAdvances[(uint8_t) glyph];
+    }
+    return playdate->graphics->getTextWidth(keyboardFont, &glyph, 1, kASCIIEncoding, 0);
+}
+
+/// @brief Draws <em>glyph</em> with its top left corner at (x, y) with the font, or with its atlas image when the font is not loaded.
+static void drawGlyph(char glyph, int x, int y) {
+    if (keyboardFont == NULL) {
+        playdate->graphics->drawBitmap(atlasGlyphImages[(uint8_t) glyph], x, y, kBitmapUnflipped);
     } else {
-        const float progress = keyboardRect.size.width / keyboardWidth;
-        for (unsigned int index = 0; index < kColumnCount; index++) {
-            columnOffsets[index] = keyboardRect.origin.x + (columnPositions[index] * progress);
+        playdate->graphics->setFont(keyboardFont);
+        playdate->graphics->drawText(&glyph, 1, kASCIIEncoding, x, y);
+    }
+}
+#endif
+
+#if PDKEYBOARD_FRAMEBUFFER
+static PDKEYBOARD_THREAD_LOCAL PDKeyboardMask * _Nullable columnMasks[kColumnMenu];
+
+static PDKeyboardMask * _Nonnull newColumnMasks(const char * _Nonnull column, unsigned int count) {
+    PDKeyboardMask *masks = playdate->system->realloc(NULL, count * sizeof(PDKeyboardMask));
+    for (unsigned int index = 0; index < count; index++) {
+        const int width = max(getGlyphWidth(column[index]), 1);
+        LCDBitmap *glyph = playdate->graphics->newBitmap(width, rowHeight, kColorClear);
+        playdate->graphics->pushContext(glyph);
+        playdate->graphics->setDrawMode(kDrawModeCopy);
+        drawGlyph(column[index], 0, 0);
+        playdate->graphics->popContext();
+        initMask(&masks[index], glyph);
+        playdate->graphics->freeBitmap(glyph);
+    }
+    return masks;
+}
+#elif PDKEYBOARD_COLUMN_STRIPS
+static PDKEYBOARD_THREAD_LOCAL LCDBitmap * _Nullable columnStrips[kColumnMenu];
+static PDKEYBOARD_THREAD_LOCAL int columnStripWidths[kColumnMenu];
+
+static LCDBitmap * _Nonnull newColumnStrip(const char * _Nonnull column, unsigned int count, int * _Nonnull width) {
+    int stripWidth = 1;
+    for (unsigned int index = 0; index < count; index++) {
+        stripWidth = max(stripWidth, getGlyphWidth(column[index]));
+    }
+    *width = stripWidth;
+
+    const unsigned int rowCount = count + kColumnWrapRowCount;
+    LCDBitmap *strip = playdate->graphics->newBitmap(stripWidth, rowCount * rowHeight, kColorClear);
+    playdate->graphics->pushContext(strip);
+    playdate->graphics->setDrawMode(kDrawModeCopy);
+    for (unsigned int row = 0; row < rowCount; row++) {
+        drawGlyph(column[row % count], 0, row * rowHeight);
+    }
+    playdate->graphics->popContext();
+    return strip;
+}
+#else
+#define kColumnTextCapacity ((sizeof(numbersColumn) + kColumnWrapRowCount) * 2)
+static PDKEYBOARD_THREAD_LOCAL char columnTexts[kColumnMenu][kColumnTextCapacity];
+
+static void initColumnText(char * _Nonnull text, const char * _Nonnull column, unsigned int count) {
+    const unsigned int rowCount = count + kColumnWrapRowCount;
+    for (unsigned int row = 0; row < rowCount; row++) {
+        text[row * 2] = column[row % count];
+        text[row * 2 + 1] = '\n';
+    }
+}
+#endif
+
+static void loadColumn(unsigned int column) {
+#if PDKEYBOARD_FRAMEBUFFER
+    columnMasks[column] = newColumnMasks(columns[column], columnCounts[column]);
+#elif PDKEYBOARD_COLUMN_STRIPS
+    columnStrips[column] = newColumnStrip(columns[column], columnCounts[column], &columnStripWidths[column]);
+#else
+    initColumnText(columnTexts[column], columns[column], columnCounts[column]);
+#endif
+}
+
+static void unloadColumns(void) {
+    for (unsigned int column = 0; column < kColumnMenu; column++) {
+#if PDKEYBOARD_FRAMEBUFFER
+        PDKeyboardMask *masks = columnMasks[column];
+        if (masks) {
+            for (unsigned int index = 0; index < columnCounts[column]; index++) {
+                freeMask(&masks[index]);
+            }
+            playdate->system->realloc(masks, 0);
+            columnMasks[column] = NULL;
         }
+#elif PDKEYBOARD_COLUMN_STRIPS
+        if (columnStrips[column]) {
+            playdate->graphics->freeBitmap(columnStrips[column]);
+            columnStrips[column] = NULL;
+        }
+#endif
     }
+}
+
+/// @brief Draws <em>rowCount</em> consecutive rows of <em>column</em>.
+/// @param glyphTop Top of the glyph of the first row.
+/// @param bottom Bottom limit of the drawn area.
+/// @param firstRow Index of the glyph of the first row.
+/// @return Number of draw calls.
+static int drawColumnRows(unsigned int column, int x, int glyphTop, int bottom, int firstRow, int rowCount) {
+    if (assetsLoadStep <= kAssetsStepColumns + column) {
+        // Not loaded yet.
+        return 0;
+    }
+#if PDKEYBOARD_FRAMEBUFFER
+    const int count = columnCounts[column];
+    for (int row = 0; row < rowCount; row++) {
+        frameDrawMask(&columnMasks[column][(firstRow + row) % count], x, glyphTop + row * rowHeight);
+    }
+    return 0;
+#elif PDKEYBOARD_COLUMN_STRIPS
+    setClipRect(x, glyphTop, columnStripWidths[column], bottom - glyphTop);
+    playdate->graphics->drawBitmap(columnStrips[column], x, glyphTop - firstRow * rowHeight, kBitmapUnflipped);
+#else
+    playdate->graphics->drawText(columnTexts[column] + firstRow * 2, rowCount * 2 - 1, kASCIIEncoding, x, glyphTop);
+#endif
+    return 1;
+}
 
-    const float leftX = keyboardRect.origin.x;
+#pragma mark - Layout
 
-    // background
-    gfx.setDrawMode(kDrawModeCopy);
-    gfx.fillRect(leftX + 2, 0, displayWidth - leftX, displayHeight, kColorBlack);
-    gfx.fillRect(leftX, 0, 2, displayHeight, kColorWhite);
+static bool_t isAnimationRunning(PDKeyboard * _Nonnull self, PDKeyboardAnimationChannel channel) {
+    return (self->runningAnimations & (1 << channel)) != 0;
+}
 
-    // selection
-    struct rectangle selectedRect = self->selectedCharacterRect;
-    selectedRect.origin.x += leftX;
-    switch (currentAnimationType) {
-        case kAnimationTypeSelectionUp:
-            selectedRect.origin.y += 3;
-            break;
-        case kAnimationTypeSelectionDown:
-            selectedRect.origin.y -= 3;
-            break;
+static bool_t isSliding(PDKeyboard * _Nonnull self) {
+    return isAnimationRunning(self, kAnimationChannelSlide);
+}
+
+/// @brief Returns the channel scrolling <em>column</em>. Upper and lower case letters move together.
+static PDKeyboardAnimationChannel getScrollChannel(PDKeyboardColumn column) {
+    switch (column) {
+        case kColumnSymbols:
+            return kAnimationChannelScrollSymbols;
+        case kColumnMenu:
+            return kAnimationChannelScrollMenu;
         default:
-            break;
+            return kAnimationChannelScrollLetters;
     }
+}
+
+/// @brief Computes the jiggle and shift of the selection from the values of their animations.
+static void updateSelectionJiggle(PDKeyboard * _Nonnull self) {
+    const PDKeyboardAnimation *animations = self->animations;
+    struct rectangle selectionJiggle = {};
 
-    const int8_t rowShift = self->rowShift;
+    const int rowShift = animations[kAnimationChannelRowShift].value;
     if (rowShift > 0) {
-        selectedRect.origin.y += 5;
-        self->rowShift = rowShift - 1;
+        selectionJiggle.origin.y += 5;
     } else if (rowShift < 0) {
-        selectedRect.origin.y -= 5;
-        self->rowShift = rowShift + 1;
+        selectionJiggle.origin.y -= 5;
     }
 
-    const int8_t rowJiggle = self->rowJiggle;
+    const int rowJiggle = animations[kAnimationChannelRowJiggle].value;
     if (rowJiggle > 0) {
-        selectedRect.origin.y -= 3;
-        selectedRect.size.height += 2;
-        self->rowJiggle = rowJiggle - 1;
+        selectionJiggle.origin.y -= 3;
+        selectionJiggle.size.height += 2;
     } else if (rowJiggle < 0) {
-        selectedRect.origin.y += 1;
-        selectedRect.size.height += 2;
-        self->rowJiggle = rowJiggle + 1;
+        selectionJiggle.origin.y += 1;
+        selectionJiggle.size.height += 2;
     }
 
-    const int8_t columnJiggle = self->columnJiggle;
+    const int columnJiggle = animations[kAnimationChannelColumnJiggle].value;
     if (columnJiggle > 0) {
-        selectedRect.origin.x += 1;
-        selectedRect.size.width += 2;
-        self->columnJiggle = columnJiggle - 1;
+        selectionJiggle.origin.x += 1;
+        selectionJiggle.size.width += 2;
     } else if (columnJiggle < 0) {
-        selectedRect.origin.x -= 3;
-        selectedRect.size.width += 2;
-        self->columnJiggle = columnJiggle + 1;
+        selectionJiggle.origin.x -= 3;
+        selectionJiggle.size.width += 2;
     }
+    self->selectionJiggle = selectionJiggle;
+}
+
+/// @brief Computes the positions of the columns and of the selection for the current frame.
+static void layoutKeyboard(PDKeyboard * _Nonnull self) {
+    PDKeyboardLayout *layout = &self->layout;
+    const bool_t animating = isSliding(self);
+    layout->animating = animating;
 
+    const struct rectangle keyboardRect = self->keyboardRect;
+    layout->keyboardRect = keyboardRect;
 
     if (!animating) {
-        fillRoundRect(selectedRect, kColorWhite);
+        for (unsigned int index = 0; index < kColumnCount; index++) {
+            layout->columnOffsets[index] = keyboardRect.origin.x + columnPositions[index];
+        }
+    } else {
+        // The width is negative when the hide slide overshoots, the left of the column stays positive.
+        const int width = self->slideStyle == kSlideStyleSolid ? keyboardWidth : keyboardRect.size.width;
+        for (unsigned int index = 0; index < kColumnCount; index++) {
+            layout->columnOffsets[index] = (keyboardRect.origin.x * keyboardWidth + columnPositions[index] * width) / keyboardWidth;
+        }
+    }
+
+    // selection
+    const PDKeyboardColumn selectedColumn = self->selectedColumn;
+    const PDKeyboardAnimationChannel selectedScrollChannel = getScrollChannel(selectedColumn);
+    struct rectangle selectedRect = self->selectedCharacterRect;
+    selectedRect.origin.x += keyboardRect.origin.x;
+    if (isAnimationRunning(self, selectedScrollChannel)) {
+        switch (self->animations[selectedScrollChannel].type) {
+            case kAnimationTypeSelectionUp:
+                selectedRect.origin.y += 3;
+                break;
+            case kAnimationTypeSelectionDown:
+                selectedRect.origin.y -= 3;
+                break;
+            default:
+                break;
+        }
     }
 
+    const struct rectangle selectionJiggle = self->selectionJiggle;
+    selectedRect.origin.x += selectionJiggle.origin.x;
+    selectedRect.origin.y += selectionJiggle.origin.y;
+    selectedRect.size.width += selectionJiggle.size.width;
+    selectedRect.size.height += selectionJiggle.size.height;
+    layout->selectedRect = selectedRect;
 
-    gfx.setDrawMode(kDrawModeNXOR);    
+    // column offsets, a column keeps scrolling after the selection left it
+    for (unsigned int index = 0; index < kColumnMenu; index++) {
+        const PDKeyboardAnimationChannel scrollChannel = getScrollChannel(index);
+        int yOffset = self->animations[scrollChannel].value;
+        if (scrollChannel == selectedScrollChannel && self->scrollingVertically) {
+            // while scrolling vertically, don't offset, instead center letters on selection rect - easier to read and looks better
+            yOffset = 0;
+        }
+        layout->columnYOffsets[index] = yOffset;
+    }
+    layout->columnYOffsets[kColumnMenu] = self->animations[kAnimationChannelScrollMenu].value;
+    memcpy(layout->selectionIndexes, self->selectionIndexes, sizeof(layout->selectionIndexes));
+}
 
+static bool_t isRectEqual(struct rectangle lhs, struct rectangle rhs) {
+    return lhs.origin.x == rhs.origin.x && lhs.origin.y == rhs.origin.y
+        && lhs.size.width == rhs.size.width && lhs.size.height == rhs.size.height;
+}
 
-    // menu column
+static bool_t isLayoutEqual(const PDKeyboardLayout * _Nonnull lhs, const PDKeyboardLayout * _Nonnull rhs) {
+    if (lhs->animating != rhs->animating
+        || !isRectEqual(lhs->keyboardRect, rhs->keyboardRect)
+        || !isRectEqual(lhs->selectedRect, rhs->selectedRect)) {
+        return false;
+    }
+    for (unsigned int index = 0; index < kColumnCount; index++) {
+        if (lhs->columnOffsets[index] != rhs->columnOffsets[index]
+            || lhs->columnYOffsets[index] != rhs->columnYOffsets[index]
+            || lhs->selectionIndexes[index] != rhs->selectionIndexes[index]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void unionRect(LCDRect * _Nonnull self, int left, int right, int top, int bottom) {
+    self->left = min(self->left, left);
+    self->right = max(self->right, right);
+    self->top = min(self->top, top);
+    self->bottom = max(self->bottom, bottom);
+}
+
+/// @brief Computes the area of the screen to redraw by comparing the current layout with the last drawn one.
+/// The horizontal bounds are extended to whole columns so that glyphs are never cut.
+static void updateDirtyRect(PDKeyboard * _Nonnull self) {
+    const PDKeyboardLayout *layout = &self->layout;
+    const PDKeyboardLayout *drawnLayout = &self->drawnLayout;
+    const int left = layout->keyboardRect.origin.x;
+    const LCDRect keyboardArea = {
+        .left = left,
+        .right = displayWidth,
+        .top = 0,
+        .bottom = displayHeight,
+    };
+    if (!self->dirtyRectTracking || self->needsDisplay
+        || layout->animating || drawnLayout->animating
+        || !isRectEqual(layout->keyboardRect, drawnLayout->keyboardRect)) {
+        self->dirtyRect = keyboardArea;
+        return;
+    }
+
+    LCDRect dirtyRect = {
+        .left = keyboardArea.right,
+        .right = keyboardArea.left,
+        .top = keyboardArea.bottom,
+        .bottom = keyboardArea.top,
+    };
+    if (!isRectEqual(layout->selectedRect, drawnLayout->selectedRect)) {
+        const struct rectangle rects[] = {layout->selectedRect, drawnLayout->selectedRect};
+        for (unsigned int index = 0; index < 2; index++) {
+            const struct rectangle rect = rects[index];
+            unionRect(&dirtyRect, rect.origin.x, rect.origin.x + rect.size.width + 1, rect.origin.y, rect.origin.y + rect.size.height + 1);
+        }
+    }
+    for (unsigned int index = 0; index < kColumnCount; index++) {
+        if (layout->columnYOffsets[index] != drawnLayout->columnYOffsets[index]
+            || layout->selectionIndexes[index] != drawnLayout->selectionIndexes[index]) {
+            const int x = layout->columnOffsets[index];
+            unionRect(&dirtyRect, x, x + columnWidths[index], keyboardArea.top, keyboardArea.bottom);
+        }
+    }
+    if (dirtyRect.left >= dirtyRect.right) {
+        self->dirtyRect = (LCDRect) {};
+        return;
+    }
+
+    // Columns are contiguous, the margins belong to the first and last ones.
+    int bounds[kColumnCount + 1] = {keyboardArea.left};
+    for (unsigned int index = 1; index < kColumnCount; index++) {
+        bounds[index] = layout->columnOffsets[index];
+    }
+    bounds[kColumnCount] = keyboardArea.right;
+    int snappedLeft = bounds[0];
+    int snappedRight = bounds[kColumnCount];
+    for (unsigned int index = 0; index <= kColumnCount; index++) {
+        if (bounds[index] <= dirtyRect.left) {
+            snappedLeft = bounds[index];
+        }
+        if (bounds[kColumnCount - index] >= dirtyRect.right) {
+            snappedRight = bounds[kColumnCount - index];
+        }
+    }
+    self->dirtyRect = (LCDRect) {
+        .left = snappedLeft,
+        .right = snappedRight,
+        .top = max(dirtyRect.top, keyboardArea.top),
+        .bottom = min(dirtyRect.bottom, keyboardArea.bottom),
+    };
+}
+
+#pragma mark - Render list
+
+static PDKeyboardDrawOp * _Nonnull appendDrawOp(PDKeyboardRenderList * _Nonnull self, PDKeyboardDrawOpType type, unsigned int column) {
+    if (self->count == kRenderListCapacity) {
+        playdate->system->error("Keyboard render list is full");
+        self->count--;
+    }
+    PDKeyboardDrawOp *op = &self->ops[self->count++];
+    *op = (PDKeyboardDrawOp) {
+        .type = type,
+        .column = column,
+    };
+    return op;
+}
+
+static void appendFillRect(PDKeyboardRenderList * _Nonnull self, unsigned int column, int x, int y, int width, int height, LCDColor color) {
+    PDKeyboardDrawOp *op = appendDrawOp(self, kDrawOpFillRect, column);
+    op->x = x;
+    op->y = y;
+    op->width = width;
+    op->height = height;
+    op->value = color;
+}
+
+static void appendHorizontalLine(PDKeyboardRenderList * _Nonnull self, unsigned int column, int x1, int x2, int y, LCDColor color) {
+    PDKeyboardDrawOp *op = appendDrawOp(self, kDrawOpHorizontalLine, column);
+    op->x = x1;
+    op->y = y;
+    op->width = x2 - x1;
+    op->value = color;
+}
+
+/// @brief Appends a rounded rect with a radius of 2, same shape as fillRoundRect.
+static void appendRoundRect(PDKeyboardRenderList * _Nonnull self, unsigned int column, struct rectangle rectangle, LCDColor color) {
+    if (rectangle.size.width < 4 || rectangle.size.height < 4) {
+        appendFillRect(self, column, rectangle.origin.x, rectangle.origin.y, rectangle.size.width, rectangle.size.height, color);
+        return;
+    }
+    appendHorizontalLine(self, column, rectangle.origin.x + 2, rectangle.origin.x + rectangle.size.width - 3, rectangle.origin.y, color);
+    appendHorizontalLine(self, column, rectangle.origin.x + 1, rectangle.origin.x + rectangle.size.width - 2, rectangle.origin.y + 1, color);
+    appendFillRect(self, column, rectangle.origin.x, rectangle.origin.y + 2, rectangle.size.width, rectangle.size.height - 4, color);
+    appendHorizontalLine(self, column, rectangle.origin.x + 1, rectangle.origin.x + rectangle.size.width - 2, rectangle.origin.y + rectangle.size.height - 2, color);
+    appendHorizontalLine(self, column, rectangle.origin.x + 2, rectangle.origin.x + rectangle.size.width - 3, rectangle.origin.y + rectangle.size.height - 1, color);
+}
+
+/// @brief Appends the visible glyphs of a letter/symbol column.
+/// @param y Top of the selected row.
+/// @param yOffset Scroll offset of the column, in fixed point.
+static void appendColumnRows(PDKeyboardRenderList * _Nonnull self, const PDKeyboardLayout * _Nonnull layout, unsigned int column, int x, int y, int yOffset) {
+    const int count = columnCounts[column];
+    const int selectedIndex = layout->selectionIndexes[column];
+
+    // Rows above and below the selected row, counted like when each glyph was drawn with its own drawText.
+    int firstRow = 0;
+    for (int rowY = y; intToFixed(rowY + rowHeight - fontHeight) + yOffset > 0; rowY -= rowHeight) {
+        firstRow--;
+    }
+    int lastRow = 0;
+    for (int rowY = y; intToFixed(rowY + rowHeight - displayHeight) + yOffset < 0; rowY += rowHeight) {
+        lastRow++;
+    }
+
+    // Glyph positions are truncated toward zero, rows are drawn together as long as they are rowHeight apart.
+    int runFirstRow = 0;
+    int runGlyphTop = 0;
+    int previousGlyphTop = 0;
+    bool_t hasRun = false;
+    for (int row = firstRow; row <= lastRow + 1; row++) {
+        const int glyphTop = row <= lastRow ? fixedToInt(intToFixed(y + row * rowHeight + 4) + yOffset) : displayHeight;
+        if (row <= lastRow && (glyphTop + rowHeight <= 0 || glyphTop >= displayHeight)) {
+            continue;
+        }
+        if (hasRun && (row > lastRow || glyphTop - previousGlyphTop != rowHeight)) {
+            const int bottom = row <= lastRow ? min(previousGlyphTop + rowHeight, glyphTop) : previousGlyphTop + rowHeight;
+            PDKeyboardDrawOp *op = appendDrawOp(self, kDrawOpColumnRows, column);
+            op->x = x;
+            op->y = runGlyphTop;
+            op->height = bottom - runGlyphTop;
+            op->value = (((selectedIndex + runFirstRow) % count) + count) % count;
+            op->count = (previousGlyphTop - runGlyphTop) / rowHeight + 1;
+            hasRun = false;
+        }
+        if (!hasRun) {
+            runFirstRow = row;
+            runGlyphTop = glyphTop;
+            hasRun = true;
+        }
+        previousGlyphTop = glyphTop;
+    }
+}
+
+/// @brief Builds the draw ops of the columns and of the selection of <em>layout</em>.
+static void buildRenderList(PDKeyboard * _Nonnull self, PDKeyboardRenderList * _Nonnull renderList, const PDKeyboardLayout * _Nonnull layout) {
     const PDKeyboardColumn selectedColumn = self->selectedColumn;
-    const uint8_t selectedMenuIndex = self->selectionIndexes[kColumnMenu];
-    const float w = columnWidths[kColumnMenu];
-    const float y = self->selectionY - (selectedMenuIndex * rowHeight) + rowHeight;
-    const float x = columnOffsets[kColumnMenu];
-    float yOffset = 0;
-    if (selectedColumn == kColumnMenu) {
-        yOffset = self->selectionYOffset;
+    renderList->count = 0;
+    renderList->isValid = true;
+    renderList->layout = *layout;
+    renderList->selectedColumn = selectedColumn;
+
+    const bool_t animating = layout->animating;
+    const int * _Nonnull columnOffsets = layout->columnOffsets;
+    const int leftX = layout->keyboardRect.origin.x;
+
+    // Fills are not affected by the draw mode: it is set once, before the first image.
+
+    // background
+    appendFillRect(renderList, kColumnCount, leftX + 2, 0, displayWidth - leftX, displayHeight, kColorBlack);
+    appendFillRect(renderList, kColumnCount, leftX, 0, 2, displayHeight, kColorWhite);
+
+    // selection
+    struct rectangle selectedRect = layout->selectedRect;
+    if (!animating) {
+        appendRoundRect(renderList, kColumnCount, selectedRect, kColorWhite);
     }
 
-    const float cx = x + menuColumnWidth / 2;
-    float cy = y - rowHeight/2 + yOffset;
+    appendDrawOp(renderList, kDrawOpDrawMode, kColumnCount)->value = kDrawModeNXOR;
+
+    // menu column
+    const uint8_t selectedMenuIndex = layout->selectionIndexes[kColumnMenu];
+    const int w = columnWidths[kColumnMenu];
+    const int y = self->selectionY - (selectedMenuIndex * rowHeight) + rowHeight;
+    const int x = columnOffsets[kColumnMenu];
+    const int yOffset = layout->columnYOffsets[kColumnMenu];
+
+    const int cx = x + menuColumnWidth / 2;
+    // Fixed point.
+    int cy = intToFixed(y - rowHeight/2) + yOffset;
 
     if (animating) {
-        gfx.setDrawMode(kDrawModeCopy);
-        gfx.fillRect(x, 0, w, displayHeight, kColorBlack);
-        gfx.setDrawMode(kDrawModeNXOR);
-        
+        appendFillRect(renderList, kColumnMenu, x, 0, w, displayHeight, kColorBlack);
         if (selectedColumn == kColumnMenu) {
             selectedRect.origin.x = x;
-            fillRoundRect(selectedRect, kColorWhite);
+            appendRoundRect(renderList, kColumnMenu, selectedRect, kColorWhite);
         }
     }
 
     for (unsigned int index = 0; index < kMenuColumnCount; index++) {
-        LCDBitmap *glyphImage = menuColumn[index];
-        struct int_size size;
-        gfx.getBitmapData(glyphImage, &size.width, &size.height, NULL, NULL, NULL);
-        gfx.drawBitmap(glyphImage, cx - size.width / 2, cy - size.height / 2, kBitmapUnflipped);
-        cy += rowHeight;
+        const struct int_size size = getMenuImageSize(index);
+        PDKeyboardDrawOp *op = appendDrawOp(renderList, kDrawOpMenuImage, kColumnMenu);
+        op->x = cx - size.width / 2;
+        op->y = fixedToInt(cy - intToFixed(size.height / 2));
+        op->value = index;
+        cy += intToFixed(rowHeight);
     }
-    
-    // letter/symbol columns
 
-    playdate->graphics->setFont(keyboardFont);
+    // letter/symbol columns
     for (unsigned int index = 0; index < kColumnMenu; index++) {
-        const float w = columnWidths[index];
-        int y = self->selectionY;
-        int y2 = y;
+        const int w = columnWidths[index];
+        const int y = self->selectionY;
         const int x = columnOffsets[index];
-        float yOffset = 0;
+        const int yOffset = layout->columnYOffsets[index];
 
-        if (index == selectedColumn
-            || (selectedColumn == kColumnLower && index == kColumnUpper)
-            || (selectedColumn == kColumnUpper && index == kColumnLower)) {
-            // while scrolling vertically, don't offset, instead center letters on selection rect - easier to read and looks better
-            if (!self->scrollingVertically) {
-                yOffset = self->selectionYOffset;
-            }
-        }
-        
         if (animating) {
-            gfx.setDrawMode(kDrawModeCopy);
-            gfx.fillRect(x, 0, w, displayHeight, kColorBlack);
-            gfx.setDrawMode(kDrawModeNXOR);
-            
+            appendFillRect(renderList, index, x, 0, w, displayHeight, kColorBlack);
             if (index == selectedColumn) {
                 selectedRect.origin.x = x;
-                fillRoundRect(selectedRect, kColorWhite);
+                appendRoundRect(renderList, index, selectedRect, kColorWhite);
             }
         }
 
-        const char *charColumn = columns[index];
-        const int selectedIndex = self->selectionIndexes[index];
-        char glyph = charColumn[selectedIndex];
-        int cx = x;
-        int cy = y + 4 + yOffset;
+        appendColumnRows(renderList, layout, index, x, y, yOffset);
+    }
+}
+
+/// @brief Draws the ops of <em>renderList</em>.
+/// @param dirtyRect Ops of the columns outside of this area are skipped.
+static void drawRenderList(PDKeyboard * _Nonnull self, const PDKeyboardRenderList * _Nonnull renderList, LCDRect dirtyRect) {
+    bool_t columnIsDirty[kColumnCount + 1];
+    for (unsigned int column = 0; column < kColumnCount; column++) {
+        const int x = renderList->layout.columnOffsets[column];
+        columnIsDirty[column] = x < dirtyRect.right && x + columnWidths[column] > dirtyRect.left;
+    }
+    columnIsDirty[kColumnCount] = true;
+
+#if !PDKEYBOARD_FRAMEBUFFER && !PDKEYBOARD_COLUMN_STRIPS
+    playdate->graphics->setFont(keyboardFont);
+    playdate->graphics->setTextLeading(rowHeight - fontHeight);
+#endif
+    int drawCalls = 0;
+#if !PDKEYBOARD_FRAMEBUFFER && PDKEYBOARD_COLUMN_STRIPS
+    // Column rows are clipped to their run, the clip is reset before the next op that is not a run.
+    bool_t isClippingRows = false;
+#endif
+    const PDKeyboardDrawOp *end = renderList->ops + renderList->count;
+    for (const PDKeyboardDrawOp *op = renderList->ops; op < end; op++) {
+        if (!columnIsDirty[op->column]) {
+            continue;
+        }
+#if !PDKEYBOARD_FRAMEBUFFER && PDKEYBOARD_COLUMN_STRIPS
+        if (isClippingRows && op->type != kDrawOpColumnRows) {
+            drawCalls += resetClipRect();
+            isClippingRows = false;
+        }
+#endif
+        switch (op->type) {
+            case kDrawOpFillRect:
+                drawCalls += fillRect(op->x, op->y, op->width, op->height, op->value);
+                break;
+            case kDrawOpHorizontalLine:
+                drawCalls += drawHorizontalLine(op->x, op->x + op->width, op->y, op->value);
+                break;
+            case kDrawOpDrawMode:
+                setDrawMode(op->value);
+                break;
+            case kDrawOpMenuImage:
+                drawCalls += drawMenuImage(op->value, op->x, op->y);
+                break;
+            case kDrawOpColumnRows:
+                drawCalls += drawColumnRows(op->column, op->x, op->y, op->y + op->height, op->value, op->count);
+#if !PDKEYBOARD_FRAMEBUFFER && PDKEYBOARD_COLUMN_STRIPS
+                isClippingRows = true;
+#endif
+                break;
+        }
+    }
+#if !PDKEYBOARD_FRAMEBUFFER && PDKEYBOARD_COLUMN_STRIPS
+    if (isClippingRows) {
+        drawCalls += resetClipRect();
+    }
+#endif
+    statsCountDrawCalls(self, drawCalls);
+}
+
+/// @brief Draws the columns and the selection of <em>layout</em>, building its render list again when it changed.
+/// @param dirtyRect Columns outside of this area are skipped.
+static void drawKeyboardLayout(PDKeyboard * _Nonnull self, const PDKeyboardLayout * _Nonnull layout, LCDRect dirtyRect) {
+    PDKeyboardRenderList *renderList = &self->renderList;
+    if (!renderList->isValid || renderList->selectedColumn != self->selectedColumn
+        || !isLayoutEqual(layout, &renderList->layout)) {
+        buildRenderList(self, renderList, layout);
+    }
+    drawRenderList(self, renderList, dirtyRect);
+}
 
-        playdate->graphics->drawText(&glyph, 1, kASCIIEncoding, cx, cy);
+#pragma mark - Draw
 
-        // letters above
-        int j = 0;
-        while (y2 + rowHeight + yOffset > fontHeight) {
-            j += 1;
-            y2 -= rowHeight;
-            cy = y2 + 4 + yOffset;
+#if !PDKEYBOARD_FRAMEBUFFER
+/// Space left between the columns of the keyboard image when they are stretched, wide enough for a jiggling selection.
+#define kKeyboardImageColumnGap 4
+static const int keyboardImageWidth = keyboardWidth + kKeyboardImageColumnGap * (kColumnCount - 1);
+
+/// @brief Renders the opened keyboard into <em>keyboardImage</em> when its content differs from <em>layout</em>.
+static void updateKeyboardImage(PDKeyboard * _Nonnull self, const PDKeyboardLayout * _Nonnull layout) {
+    // Same content as layout but at the left of the image and with the columns at their final position.
+    PDKeyboardLayout imageLayout = *layout;
+    imageLayout.keyboardRect.origin.x = 0;
+    imageLayout.keyboardRect.size.width = keyboardImageWidth;
+    // Replaced by the column offset while animating.
+    imageLayout.selectedRect.origin.x = 0;
+    // Stretched columns are cut from the image, they must not overlap.
+    const int columnGap = self->slideStyle == kSlideStyleStretchedColumns ? kKeyboardImageColumnGap : 0;
+    for (unsigned int index = 0; index < kColumnCount; index++) {
+        imageLayout.columnOffsets[index] = columnPositions[index] + columnGap * index;
+    }
+    if (self->keyboardImageIsValid && self->keyboardImageColumn == self->selectedColumn
+        && isLayoutEqual(&imageLayout, &self->keyboardImageLayout)) {
+        return;
+    }
+    if (!self->keyboardImage) {
+        self->keyboardImage = playdate->graphics->newBitmap(keyboardImageWidth, displayHeight, kColorBlack);
+    }
+    self->keyboardImageLayout = imageLayout;
+    self->keyboardImageColumn = self->selectedColumn;
+    self->keyboardImageIsValid = true;
 
-            glyph = charColumn[(selectedIndex - j + columnCounts[index]) % (columnCounts[index])];
-            playdate->graphics->drawText(&glyph, 1, kASCIIEncoding, cx, cy);
+    const LCDRect clip = drawingClip;
+    drawingClip = screenRect;
+    playdate->graphics->pushContext(self->keyboardImage);
+    drawKeyboardLayout(self, &imageLayout, screenRect);
+    playdate->graphics->popContext();
+    drawingClip = clip;
+    statsCountDrawCalls(self, 2);
+}
+
+/// @brief Draws the show/hide slide from the image of the opened keyboard.
+static void drawKeyboardImage(PDKeyboard * _Nonnull self, const PDKeyboardLayout * _Nonnull layout) {
+    updateKeyboardImage(self, layout);
+
+    LCDBitmap *keyboardImage = self->keyboardImage;
+    const int leftX = layout->keyboardRect.origin.x;
+    setDrawMode(kDrawModeCopy);
+
+    if (self->slideStyle == kSlideStyleSolid) {
+        playdate->graphics->drawBitmap(keyboardImage, leftX, 0, kBitmapUnflipped);
+        statsCountDrawCalls(self, 1);
+        // outBackEase overshoots, the right margin can be wider than in the image.
+        if (leftX + keyboardImageWidth < displayWidth) {
+            statsCountDrawCalls(self, fillRect(leftX + keyboardImageWidth, 0, displayWidth - leftX - keyboardImageWidth, displayHeight, kColorBlack));
         }
+        return;
+    }
 
-        // letters below
-        j = 0;
-        while (y + rowHeight + yOffset < displayHeight) {
-            j += 1;
-            y += rowHeight;
-            cy = y + 4 + yOffset;
-            
-            glyph = charColumn[(selectedIndex + j) % (columnCounts[index])];
-            playdate->graphics->drawText(&glyph, 1, kASCIIEncoding, cx, cy);
-            
+    // Each column is cut from the image and drawn at its stretched offset, in the order used by drawKeyboardLayout.
+    statsCountDrawCalls(self, fillRect(leftX + 2, 0, displayWidth - leftX, displayHeight, kColorBlack));
+    statsCountDrawCalls(self, fillRect(leftX, 0, 2, displayHeight, kColorWhite));
+    static const PDKeyboardColumn columnOrder[] = {kColumnMenu, kColumnSymbols, kColumnUpper, kColumnLower};
+    for (unsigned int index = 0; index < kColumnCount; index++) {
+        const PDKeyboardColumn column = columnOrder[index];
+        const int x = layout->columnOffsets[column];
+        const int w = columnWidths[column];
+        statsCountDrawCalls(self, setClipRect(x, 0, w, displayHeight));
+        playdate->graphics->drawBitmap(keyboardImage, x - self->keyboardImageLayout.columnOffsets[column], 0, kBitmapUnflipped);
+        statsCountDrawCalls(self, 1);
+
+        // A jiggling selection is wider than its column, the part outside of the column is drawn over the next one.
+        struct rectangle selectedRect = layout->selectedRect;
+        if (column == self->selectedColumn && selectedRect.size.width > w) {
+            statsCountDrawCalls(self, setClipRect(x + w, 0, selectedRect.size.width - w, displayHeight));
+            selectedRect.origin.x = x;
+            statsCountDrawCalls(self, fillRoundRect(selectedRect, kColorWhite));
         }
     }
+    statsCountDrawCalls(self, resetClipRect());
 }
+#endif
+
+static void drawKeyboard(PDKeyboard * _Nonnull self) {
+    const PDKeyboardLayout *layout = &self->layout;
+    const LCDRect dirtyRect = self->dirtyRect;
+    if (dirtyRect.left >= dirtyRect.right || dirtyRect.top >= dirtyRect.bottom) {
+        return;
+    }
+
+#if !PDKEYBOARD_FRAMEBUFFER && !PDKEYBOARD_COLUMN_STRIPS
+    // The columns change the font and the text leading, popContext gives back the ones of the game.
+    playdate->graphics->pushContext(NULL);
+    statsCountDrawCalls(self, 1);
+#endif
+    statsCountDrawCalls(self, beginDrawing(self->dirtyRectTracking ? &dirtyRect : NULL));
+#if !PDKEYBOARD_FRAMEBUFFER
+    if (layout->animating) {
+        drawKeyboardImage(self, layout);
+    } else {
+        drawKeyboardLayout(self, layout, dirtyRect);
+    }
+#else
+    drawKeyboardLayout(self, layout, dirtyRect);
+#endif
+    statsCountDrawCalls(self, endDrawing());
+#if !PDKEYBOARD_FRAMEBUFFER && !PDKEYBOARD_COLUMN_STRIPS
+    playdate->graphics->popContext();
+    statsCountDrawCalls(self, 1);
+#endif
+    self->drawnLayout = *layout;
+    self->needsDisplay = false;
+}
+
 
 #pragma mark Text
 
@@ -528,16 +1929,21 @@ static void PDKeyboardMutableTextEnsureCapacity(PDKeyboardMutableText * _Nonnull
 static void PDKeyboardMutableTextGrow(PDKeyboardMutableText * _Nonnull self, int newSize) {
     self->super.data = playdate->system->realloc(self->super.data, newSize * sizeof(char));
     self->capacity = newSize;
+#if PDKEYBOARD_STATS
+    self->reallocCount++;
+#endif
 }
 
 #pragma mark - Menu Commands
 
 static void hideKeyboard(PDKeyboard * _Nonnull self, bool_t okPressed) {
     self->okButtonPressed = okPressed;
-    PDKeyboardHide(self);
+    startHideAnimation(self);
 
     // free up memory
-    freeSounds(self);
+    if (self->soundResidency == kSoundResidencyOnDemand) {
+        freeSounds(self);
+    }
     PDKeyboardTextFree(&self->originalText);
 }
 
@@ -613,105 +2019,146 @@ static void enterKey(PDKeyboard * _Nonnull self) {
         addLetter(self, newLetter);
         self->lastTypedColumn = selectedColumn;
     }
-    playSound(&self->samplePlayer, &self->keySound, kSoundKeyPress);
+    playSound(self, kSoundKeyPress);
 }
 
 
+/// @brief Enters the selected key once for each repeat of A that is due.
+static void repeatEnterKey(PDKeyboard * _Nonnull self) {
+    const unsigned int count = takeRepeats(&self->nextKeyRepeatTime, self->input.time, kKeyRepeatMilliseconds);
+    // OK starts the hide animation, the next repeats are ignored.
+    for (unsigned int index = 0; index < count && !isSliding(self); index++) {
+        enterKey(self);
+    }
+}
+
 static void enterNewLetterIfNecessary(PDKeyboard * _Nonnull self) {
-    if (!self->isVisible || isShowOrHideAnimation(self->currentAnimationType)) {
+    if (!self->isVisible || isSliding(self)) {
         return;
     }
     
-    const unsigned int currentMillis = playdate->system->getCurrentTimeMilliseconds();
-    
-    PDButtons pressing;
-    PDButtons justPressed;
-    playdate->system->getButtonState(&pressing, &justPressed, NULL);
+    const unsigned int currentMillis = self->input.time;
+    const PDButtons pressing = self->input.current;
+    const PDButtons justPressed = self->input.pushed;
+    if (self->usesFrameButtonEvents) {
+        // Presses are entered by handleButtonEvents, in order with the other buttons.
+        if ((pressing & kButtonA) && !(justPressed & kButtonA)) {
+            repeatEnterKey(self);
+        }
+        return;
+    }
     if ((justPressed & kButtonA) && (currentMillis > self->lastKeyEnteredTime + minKeyRepeatMilliseconds)) {
         enterKey(self);
         self->lastKeyEnteredTime = currentMillis;
-        
-        const float initialKeyRepeatSeconds = 0.3f;
-        self->keyRepeatDelay = floorf(initialKeyRepeatSeconds * self->refreshRate);
+        self->nextKeyRepeatTime = currentMillis + kInitialKeyRepeatMilliseconds;
     }
     else if (pressing & kButtonA) {
-        if (self->keyRepeatDelay <= 0) {
-            enterKey(self);
-            const float keyRepeatSeconds = 0.1f; // the following repeat delays should be shorter
-            self->keyRepeatDelay = floorf(keyRepeatSeconds * self->refreshRate);
-        } else {
-            self->keyRepeatDelay--;
-        }
+        repeatEnterKey(self);
     }
 }
 
 #pragma mark - Animations
 
-static void updateAnimation(PDKeyboard * _Nonnull self) {
-    const unsigned int animationTime = playdate->system->getCurrentTimeMilliseconds() - self->animationStartTime;
+/// @brief Returns the value of <em>animation</em> <em>time</em> milliseconds after its start, <em>time</em> being
+/// lower than its duration.
+static int getAnimationValue(const PDKeyboardAnimation * _Nonnull animation, unsigned int time) {
+    switch (animation->easing) {
+        case kEasingLinear:
+            return linearEaseFixed(time, animation->from, animation->to - animation->from, animation->duration);
+        case kEasingShowSlide:
+            return showSlideLefts[time];
+        case kEasingHideSlide:
+            return hideSlideLefts[time];
+        case kEasingStep:
+        default:
+            return animation->from;
+    }
+}
 
-    if (animationTime >= self->animationDuration) {
-        // animation ended
-        switch (self->currentAnimationType) {
-            case kAnimationTypeKeyboardShow:
-                self->keyboardRect.origin.x = displayWidth - keyboardWidth;
-                if (self->keyboardDidShowCallback) {
-                    self->keyboardDidShowCallback(self->keyboardDidShowCallbackUserdata);
-                }
-                break;
-            case kAnimationTypeKeyboardHide:
-                self->keyboardRect.origin.x = displayWidth;
-                self->isVisible = false;
-                // reset main update function
-                playdate->system->setUpdateCallback(self->playdateUpdate, self->playdateUpdateUserdata);
-                if (self->keyboardDidHideCallback) {
-                    self->keyboardDidHideCallback(self->keyboardDidHideCallbackUserdata);
-                }
-                self->text.super.count = 0;
-                break;
-            case kAnimationTypeSelectionUp:
-            case kAnimationTypeSelectionDown:
-                self->selectionYOffset = 0;
-                break;
-            default:
-                // Nothing to do.
-                break;
+/// @brief Sets the animation of <em>channel</em> to its end value and runs its end action, if it is running.
+static void finishAnimation(PDKeyboard * _Nonnull self, PDKeyboardAnimationChannel channel) {
+    if (!isAnimationRunning(self, channel)) {
+        return;
+    }
+    self->runningAnimations &= ~(1 << channel);
+    PDKeyboardAnimation *animation = &self->animations[channel];
+    animation->value = animation->to;
+
+    switch (animation->type) {
+        case kAnimationTypeKeyboardShow:
+            self->keyboardRect.origin.x = animation->value;
+            if (!self->isReady) {
+                // Assets that could not be loaded during the slide are loaded now.
+                loadFontAndImages();
+                continueLoading(self);
+            }
+            if (self->keyboardDidShowCallback) {
+                self->keyboardDidShowCallback(self->keyboardDidShowCallbackUserdata);
+            }
+            break;
+        case kAnimationTypeKeyboardHide:
+            self->keyboardRect.origin.x = animation->value;
+            self->isVisible = false;
+            if (self->soundResidency == kSoundResidencyWhileVisible) {
+                freeSounds(self);
+            }
+            // reset main update function
+            playdate->system->setUpdateCallback(self->playdateUpdate, self->playdateUpdateUserdata);
+            restoreButtonCallback(self);
+            if (self->keyboardDidHideCallback) {
+                self->keyboardDidHideCallback(self->keyboardDidHideCallbackUserdata);
+            }
+            self->text.super.count = 0;
+            break;
+        default:
+            // Nothing to do.
+            break;
+    }
+}
+
+/// @brief Advances every running animation to <em>now</em> in a single pass.
+static void updateAnimations(PDKeyboard * _Nonnull self, unsigned int now) {
+    for (unsigned int channel = 0; channel < kAnimationChannelCount; channel++) {
+        if (!isAnimationRunning(self, channel)) {
+            continue;
         }
-        self->currentAnimationType = kAnimationTypeNone;
-    }
-    else {
-        // see what type of animation we are running, and continue it
-        switch (self->currentAnimationType) {
-            case kAnimationTypeKeyboardShow:
-                self->keyboardRect.origin.x = outBackEase(animationTime, displayWidth, - keyboardWidth, self->animationDuration, 1);
-                self->keyboardRect.size.width = displayWidth - self->keyboardRect.origin.x;
-                break;
-            case kAnimationTypeKeyboardHide:
-                self->keyboardRect.origin.x = outBackEase(animationTime, displayWidth - keyboardWidth, keyboardWidth, self->animationDuration, 1);
-                self->keyboardRect.size.width = displayWidth - self->keyboardRect.origin.x;
-                break;
-            case kAnimationTypeSelectionUp:
-            case kAnimationTypeSelectionDown:
-                self->selectionYOffset = linearEase(animationTime, self->selectionStartY, -self->selectionStartY, self->animationDuration);
-                break;
-            default:
-                // Nothing to do.
-                break;
+        PDKeyboardAnimation *animation = &self->animations[channel];
+        const unsigned int animationTime = now - animation->startTime;
+        if (animationTime >= animation->duration) {
+            finishAnimation(self, channel);
+        } else {
+            animation->value = getAnimationValue(animation, animationTime);
+            if (channel == kAnimationChannelSlide) {
+                self->keyboardRect.origin.x = animation->value;
+                self->keyboardRect.size.width = displayWidth - animation->value;
+            }
         }
     }
 }
 
-
-static void startAnimation(PDKeyboard * _Nonnull self, PDKeyboardAnimationType animationType, unsigned int duration) {
-    // finish the last animation before starting this one
-    if (self->currentAnimationType != kAnimationTypeNone) {
-        self->animationDuration = playdate->system->getCurrentTimeMilliseconds() - self->animationStartTime;
-        updateAnimation(self);
+static void finishAnimations(PDKeyboard * _Nonnull self) {
+    for (unsigned int channel = 0; channel < kAnimationChannelCount; channel++) {
+        finishAnimation(self, channel);
     }
-    
-    self->animationDuration = duration;
-    self->currentAnimationType = animationType;
-    self->animationStartTime = playdate->system->getCurrentTimeMilliseconds();
+}
+
+/// @brief Replaces the animation of <em>channel</em> by <em>animation</em>, its value is computed for
+/// <em>now</em> so that it can start before the current time.
+static void startAnimation(PDKeyboard * _Nonnull self, PDKeyboardAnimationChannel channel, PDKeyboardAnimation animation, unsigned int now) {
+    animation.value = getAnimationValue(&animation, now - animation.startTime);
+    self->animations[channel] = animation;
+    self->runningAnimations |= 1 << channel;
+}
+
+static void startSelectionJiggle(PDKeyboard * _Nonnull self, PDKeyboardAnimationChannel channel, int direction) {
+    const unsigned int now = self->input.time;
+    startAnimation(self, channel, (PDKeyboardAnimation) {
+        .type = kAnimationTypeSelectionJiggle,
+        .easing = kEasingStep,
+        .startTime = now,
+        .duration = kSelectionEffectMilliseconds,
+        .from = direction,
+    }, now);
 }
 
 #pragma mark - Selection
@@ -719,7 +2166,7 @@ static void startAnimation(PDKeyboard * _Nonnull self, PDKeyboardAnimationType a
 static const unsigned int scrollAnimationDuration = 150;
 
 static void moveSelectionUp(PDKeyboard * _Nonnull self, int count, bool_t shiftRow) {
-    if (isShowOrHideAnimation(self->currentAnimationType)) {
+    if (isSliding(self)) {
         return;
     }
 
@@ -730,18 +2177,15 @@ static void moveSelectionUp(PDKeyboard * _Nonnull self, int count, bool_t shiftR
 
     int8_t *selectionIndexes = self->selectionIndexes;
     if (selectedColumn == kColumnMenu && selectionIndexes[kColumnMenu] == 0) {
-        if (self->refreshRate > 30) {
-            self->rowJiggle = 2;
-        } else {
-            self->rowJiggle = 1;
-        }
-        playSound(&self->samplePlayer, &self->bumpSound, kSoundBump);
+        startSelectionJiggle(self, kAnimationChannelRowJiggle, 1);
+        playSound(self, kSoundBump);
         return;
     }
 
     // moving the selection up means moving the letters down. Set an offset that goes from position of the old current letter and animates to zero
 
-    selectionIndexes[selectedColumn] = (selectionIndexes[selectedColumn] - count + columnCounts[selectedColumn]) % columnCounts[selectedColumn];
+    const int columnCount = columnCounts[selectedColumn];
+    selectionIndexes[selectedColumn] = ((selectionIndexes[selectedColumn] - count) % columnCount + columnCount) % columnCount;
 
     // move upper and lower alphabets together
     if (selectedColumn == kColumnLower) {
@@ -750,27 +2194,28 @@ static void moveSelectionUp(PDKeyboard * _Nonnull self, int count, bool_t shiftR
         selectionIndexes[kColumnLower] = selectionIndexes[kColumnUpper];
     }
 
-    self->selectionYOffset -= (rowHeight * count);
-    self->selectionStartY = self->selectionYOffset;
-
-    startAnimation(self, kAnimationTypeSelectionUp, scrollAnimationDuration);
-    // let the animation think it's already been going on for a frame
-    self->animationStartTime = playdate->system->getCurrentTimeMilliseconds() - (1000 / self->refreshRate);
+    // A running scroll of the column continues from where it is.
+    const PDKeyboardAnimationChannel channel = getScrollChannel(selectedColumn);
+    const unsigned int now = self->input.time;
+    startAnimation(self, channel, (PDKeyboardAnimation) {
+        .type = kAnimationTypeSelectionUp,
+        .easing = kEasingLinear,
+        // let the animation think it's already been going on for a frame
+        .startTime = now - self->frameDurationMilliseconds,
+        .duration = scrollAnimationDuration,
+        .from = self->animations[channel].value - intToFixed(rowHeight * count),
+    }, now);
     
     if (shiftRow) {
-        if (self->refreshRate > 30) {
-            self->rowShift = -2;
-        } else {
-            self->rowShift = -1;
-        }
+        startSelectionJiggle(self, kAnimationChannelRowShift, -1);
     }
 
-    playSound(&self->samplePlayer, &self->rowSound, kSoundRowMove);
+    playSound(self, kSoundRowMove);
 }
 
 
 static void moveSelectionDown(PDKeyboard * _Nonnull self, int count, bool_t shiftRow) {
-    if (isShowOrHideAnimation(self->currentAnimationType)) {
+    if (isSliding(self)) {
         return;
     }
 
@@ -781,12 +2226,8 @@ static void moveSelectionDown(PDKeyboard * _Nonnull self, int count, bool_t shif
 
     int8_t *selectionIndexes = self->selectionIndexes;
     if (selectedColumn == kColumnMenu && selectionIndexes[kColumnMenu] == kMenuColumnCount - 1) {
-        if (self->refreshRate > 30) {
-            self->rowJiggle = 2;
-        } else {
-            self->rowJiggle = 1;
-        }
-        playSound(&self->samplePlayer, &self->bumpSound, kSoundBump);
+        startSelectionJiggle(self, kAnimationChannelRowJiggle, 1);
+        playSound(self, kSoundBump);
         return;
     }
 
@@ -799,33 +2240,32 @@ static void moveSelectionDown(PDKeyboard * _Nonnull self, int count, bool_t shif
         selectionIndexes[kColumnLower] = selectionIndexes[kColumnUpper];
     }
 
-    self->selectionYOffset += (rowHeight * count);
-    self->selectionStartY = self->selectionYOffset;
-
-    startAnimation(self, kAnimationTypeSelectionDown, scrollAnimationDuration);
-    // let the animation think it's already been going on for a frame
-    self->animationStartTime = playdate->system->getCurrentTimeMilliseconds() - (1000 / self->refreshRate);
+    // A running scroll of the column continues from where it is.
+    const PDKeyboardAnimationChannel channel = getScrollChannel(selectedColumn);
+    const unsigned int now = self->input.time;
+    startAnimation(self, channel, (PDKeyboardAnimation) {
+        .type = kAnimationTypeSelectionDown,
+        .easing = kEasingLinear,
+        // let the animation think it's already been going on for a frame
+        .startTime = now - self->frameDurationMilliseconds,
+        .duration = scrollAnimationDuration,
+        .from = self->animations[channel].value + intToFixed(rowHeight * count),
+    }, now);
 
     if (shiftRow) {
-        if (self->refreshRate > 30) {
-            self->rowShift = 2;
-        } else {
-            self->rowShift = 1;
-        }
+        startSelectionJiggle(self, kAnimationChannelRowShift, 1);
     }
 
-    playSound(&self->samplePlayer, &self->rowSound, kSoundRowMove);
+    playSound(self, kSoundRowMove);
 }
 
 
 static void jiggleColumn(PDKeyboard * _Nonnull self, PDKeyboardJiggleDirection jiggleDirection) {
-    const int numFrames = self->refreshRate > 30 ? 2 : 1;
-    
-    self->columnJiggle = jiggleDirection * numFrames;
+    startSelectionJiggle(self, kAnimationChannelColumnJiggle, jiggleDirection);
 }
 
 static void selectColumn(PDKeyboard * _Nonnull self, PDKeyboardColumn column) {
-    if (isShowOrHideAnimation(self->currentAnimationType)) {
+    if (isSliding(self)) {
         return;
     }
 
@@ -837,9 +2277,9 @@ static void selectColumn(PDKeyboard * _Nonnull self, PDKeyboardColumn column) {
     }
 
     if (column > selectedColumn) {
-        playSound(&self->samplePlayer, &self->columnNextSound, kSoundColumnMoveNext);
+        playSound(self, kSoundColumnMoveNext);
     } else {
-        playSound(&self->samplePlayer, &self->columnPreviousSound, kSoundColumnMovePrevious);
+        playSound(self, kSoundColumnMovePrevious);
     }
 
     self->selectedColumn = column;
@@ -852,7 +2292,7 @@ static void selectColumn(PDKeyboard * _Nonnull self, PDKeyboardColumn column) {
 
 
 static void selectPreviousColumn(PDKeyboard * _Nonnull self) {
-    if (isShowOrHideAnimation(self->currentAnimationType)) {
+    if (isSliding(self)) {
         return;
     }
 
@@ -862,11 +2302,11 @@ static void selectPreviousColumn(PDKeyboard * _Nonnull self) {
     selectedCharacterRect.origin.x = columnPositions[selectedColumn];
     selectedCharacterRect.size.width = columnWidths[selectedColumn];
     self->selectedCharacterRect = selectedCharacterRect;
-    playSound(&self->samplePlayer, &self->columnNextSound, kSoundColumnMoveNext);
+    playSound(self, kSoundColumnMoveNext);
 }
 
 static void selectNextColumn(PDKeyboard * _Nonnull self) {
-    if (isShowOrHideAnimation(self->currentAnimationType)) {
+    if (isSliding(self)) {
         return;
     }
 
@@ -876,51 +2316,114 @@ static void selectNextColumn(PDKeyboard * _Nonnull self) {
     selectedCharacterRect.origin.x = columnPositions[selectedColumn];
     selectedCharacterRect.size.width = columnWidths[selectedColumn];
     self->selectedCharacterRect = selectedCharacterRect;
-    playSound(&self->samplePlayer, &self->columnPreviousSound, kSoundColumnMovePrevious);
+    playSound(self, kSoundColumnMovePrevious);
 }
 
 
-static void checkButtonInputs(PDKeyboard * _Nonnull self) {
-    int8_t scrollRepeatDelay = self->scrollRepeatDelay;
-    int8_t keyRepeatDelay = self->keyRepeatDelay;
+/// @brief Moves the selection once for each scroll repeat that is due, up when <em>up</em> is true.
+static void repeatScroll(PDKeyboard * _Nonnull self, bool_t up) {
+    const unsigned int count = takeRepeats(&self->nextScrollRepeatTime, self->input.time, kScrollRepeatMilliseconds);
+    if (count == 0) {
+        return;
+    }
+    if (up) {
+        moveSelectionUp(self, count, true);
+    } else {
+        moveSelectionDown(self, count, true);
+    }
+    self->scrollingVertically = true;
+}
+
+/// @brief Deletes once for each repeat of B that is due.
+static void repeatDelete(PDKeyboard * _Nonnull self) {
+    const unsigned int count = takeRepeats(&self->nextKeyRepeatTime, self->input.time, kKeyRepeatMilliseconds);
+    if (count == 0) {
+        return;
+    }
+    playSound(self, kSoundKeyPress);
+    for (unsigned int index = 0; index < count; index++) {
+        deleteAction(self);
+    }
+}
 
-    PDButtons pressing;
-    PDButtons justPressed;
-    PDButtons justReleased;
-    playdate->system->getButtonState(&pressing, &justPressed, &justReleased);
+/// @brief Handles every press and release of the frame in order, then the repeats of the buttons held down
+/// since an earlier frame.
+static void handleButtonEvents(PDKeyboard * _Nonnull self) {
+    for (unsigned int index = 0; index < self->frameButtonEventCount; index++) {
+        const PDKeyboardButtonEvent event = self->frameButtonEvents[index];
+        if (!event.down) {
+            if (event.button & (kButtonUp | kButtonDown)) {
+                self->scrollingVertically = false;
+            }
+            continue;
+        }
+        switch (event.button) {
+            case kButtonUp:
+                moveSelectionUp(self, 1, true);
+                self->nextScrollRepeatTime = event.time + kInitialScrollRepeatMilliseconds;
+                break;
+            case kButtonDown:
+                moveSelectionDown(self, 1, true);
+                self->nextScrollRepeatTime = event.time + kInitialScrollRepeatMilliseconds;
+                break;
+            case kButtonLeft:
+                selectPreviousColumn(self);
+                break;
+            case kButtonRight:
+                selectNextColumn(self);
+                break;
+            case kButtonA:
+                if (self->isVisible && !isSliding(self) && event.time > self->lastKeyEnteredTime + minKeyRepeatMilliseconds) {
+                    enterKey(self);
+                    self->lastKeyEnteredTime = event.time;
+                    self->nextKeyRepeatTime = event.time + kInitialKeyRepeatMilliseconds;
+                }
+                break;
+            case kButtonB:
+                playSound(self, kSoundKeyPress);
+                deleteAction(self);
+                self->nextKeyRepeatTime = event.time + kInitialKeyRepeatMilliseconds;
+                break;
+            default:
+                break;
+        }
+    }
+
+    const PDButtons held = self->input.current & ~self->input.pushed;
+    if (held & (kButtonUp | kButtonDown)) {
+        repeatScroll(self, held & kButtonUp);
+    }
+    if (held & kButtonB) {
+        repeatDelete(self);
+    }
+}
+
+static void checkButtonInputs(PDKeyboard * _Nonnull self) {
+    if (self->usesFrameButtonEvents) {
+        handleButtonEvents(self);
+        return;
+    }
+    const unsigned int now = self->input.time;
+    const PDButtons pressing = self->input.current;
+    const PDButtons justPressed = self->input.pushed;
+    const PDButtons justReleased = self->input.released;
 
     if (justPressed & kButtonUp) {
         moveSelectionUp(self, 1, true);
-        scrollRepeatDelay = self->frameRateAdjustedScrollRepeatDelay;
+        self->nextScrollRepeatTime = now + kInitialScrollRepeatMilliseconds;
     }
     else if (pressing & kButtonUp) {
-        if (scrollRepeatDelay <= 0) {
-            moveSelectionUp(self, 1, true);
-            self->scrollingVertically = true;
-            if (self->refreshRate > 30) {
-                scrollRepeatDelay = 1;
-            }
-        } else {
-            scrollRepeatDelay--;
-        }
+        repeatScroll(self, true);
     }
     else if (justReleased & kButtonUp) {
         self->scrollingVertically = false;
     }
     else if (justPressed & kButtonDown) {
         moveSelectionDown(self, 1, true);
-        scrollRepeatDelay = self->frameRateAdjustedScrollRepeatDelay;
+        self->nextScrollRepeatTime = now + kInitialScrollRepeatMilliseconds;
     }
     else if (pressing & kButtonDown) {
-        if (scrollRepeatDelay <= 0) {
-            moveSelectionDown(self, 1, true);
-            self->scrollingVertically = true;
-            if (self->refreshRate > 30) {
-                scrollRepeatDelay = 1;
-            }
-        } else {
-            scrollRepeatDelay--;
-        }
+        repeatScroll(self, false);
     }
     else if (justReleased & kButtonDown) {
         self->scrollingVertically = false;
@@ -932,60 +2435,513 @@ static void checkButtonInputs(PDKeyboard * _Nonnull self) {
         selectNextColumn(self);
     }
     else if (justPressed & kButtonB) {
-        playSound(&self->samplePlayer, &self->keySound, kSoundKeyPress);
+        playSound(self, kSoundKeyPress);
         deleteAction(self);
-        const float initialKeyRepeatSeconds = 0.3f;
-        keyRepeatDelay = floorf(initialKeyRepeatSeconds * self->refreshRate);
+        self->nextKeyRepeatTime = now + kInitialKeyRepeatMilliseconds;
     }
     else if (pressing & kButtonB) {
-        if (keyRepeatDelay <= 0) {
-            playSound(&self->samplePlayer, &self->keySound, kSoundKeyPress);
-            deleteAction(self);
-            const float keyRepeatSeconds = 0.1f;
-            keyRepeatDelay = floorf(keyRepeatSeconds * self->refreshRate);
-        } else {
-            keyRepeatDelay--;
+        repeatDelete(self);
+    }
+}
+
+#pragma mark - Recording
+
+// Recordings are made of a header followed by records. Numbers are little endian.
+// Header: "PDKR", version (u8), start time in milliseconds (u32), refresh rate (f32),
+// capitalization behavior (u8).
+// Each record starts with a tag (u8) and the time of the record minus the time of
+// the previous one in milliseconds (zigzag varint). Frames are written at the end
+// of keyboardUpdate with the time read at the start of the frame, API calls made
+// by the app during the frame are written before their frame.
+
+static const uint8_t kRecordingMagic[] = {'P', 'D', 'K', 'R'};
+static const uint8_t kRecordingVersion = 1;
+
+typedef enum {
+    /// Pressing, pushed and released buttons (u8 each).
+    kRecordFrame = 1,
+    /// Same as kRecordFrame, followed by the crank change (f32).
+    kRecordCrankFrame = 2,
+    /// Frame without any button nor crank change.
+    kRecordIdleFrame = 3,
+    /// Text length (varint) followed by the text.
+    kRecordShow = 4,
+    kRecordHide = 5,
+    /// Refresh rate (f32).
+    kRecordRefreshRate = 6,
+    /// Capitalization behavior (u8).
+    kRecordCapitalization = 7,
+    /// Slide style (u8), also written after the header when it is not the default one.
+    kRecordSlideStyle = 8,
+    /// Sensitivity (f32), ticks per revolution and max clicks per frame (varint each), also written after
+    /// the header when it is not the default one.
+    kRecordCrankProfile = 9,
+    /// Event count (varint) then, for each event, button (u8), down (u8) and time minus the time of the
+    /// frame (zigzag varint). Written before the frame that handled the events.
+    kRecordButtonEvents = 10,
+    /// Input mode (u8), also written after the header when it is not the default one.
+    kRecordInputMode = 11,
+} PDKeyboardRecordTag;
+
+static void recorderFlush(PDKeyboard * _Nonnull self) {
+    PDKeyboardRecorder *recorder = self->recorder;
+    if (recorder->count > 0 && playdate->file->write(recorder->file, recorder->buffer, recorder->count) < 0) {
+        playdate->system->logToConsole("Unable to write keyboard recording: %s", playdate->file->geterr());
+    }
+    recorder->count = 0;
+}
+
+static void recorderWrite(PDKeyboard * _Nonnull self, const void * _Nonnull bytes, unsigned int count) {
+    PDKeyboardRecorder *recorder = self->recorder;
+    if (recorder->count + count > kRecorderBufferSize) {
+        recorderFlush(self);
+    }
+    if (count > kRecorderBufferSize) {
+        playdate->file->write(recorder->file, bytes, count);
+        return;
+    }
+    memcpy(recorder->buffer + recorder->count, bytes, count);
+    recorder->count += count;
+}
+
+static void recorderWriteVarint(PDKeyboard * _Nonnull self, uint32_t value) {
+    uint8_t bytes[5];
+    unsigned int count = 0;
+    do {
+        bytes[count] = value & 0x7F;
+        value >>= 7;
+        if (value) {
+            bytes[count] |= 0x80;
         }
+        count++;
+    } while (value);
+    recorderWrite(self, bytes, count);
+}
+
+static void recorderWriteUInt32(PDKeyboard * _Nonnull self, uint32_t value) {
+    const uint8_t bytes[] = {value, value >> 8, value >> 16, value >> 24};
+    recorderWrite(self, bytes, sizeof(bytes));
+}
+
+static void recorderWriteFloat(PDKeyboard * _Nonnull self, float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    recorderWriteUInt32(self, bits);
+}
+
+static void recorderWriteZigzag(PDKeyboard * _Nonnull self, int32_t value) {
+    recorderWriteVarint(self, ((uint32_t) value << 1) ^ (uint32_t) (value >> 31));
+}
+
+static void recorderBeginRecord(PDKeyboard * _Nonnull self, PDKeyboardRecordTag tag, unsigned int time) {
+    const uint8_t tagByte = tag;
+    recorderWrite(self, &tagByte, 1);
+    recorderWriteZigzag(self, (int32_t) (time - self->recorder->lastTime));
+    self->recorder->lastTime = time;
+}
+
+static void recordButtonEvents(PDKeyboard * _Nonnull self) {
+    const unsigned int time = self->input.time;
+    recorderBeginRecord(self, kRecordButtonEvents, time);
+    recorderWriteVarint(self, self->frameButtonEventCount);
+    for (unsigned int index = 0; index < self->frameButtonEventCount; index++) {
+        const PDKeyboardButtonEvent *event = &self->frameButtonEvents[index];
+        const uint8_t bytes[] = {event->button, event->down};
+        recorderWrite(self, bytes, sizeof(bytes));
+        recorderWriteZigzag(self, (int32_t) (event->time - time));
     }
-    self->scrollRepeatDelay = scrollRepeatDelay;
-    self->keyRepeatDelay = keyRepeatDelay;
+}
+
+static void recordFrame(PDKeyboard * _Nonnull self) {
+    const PDKeyboardInput input = self->input;
+    if (self->usesFrameButtonEvents && self->frameButtonEventCount > 0) {
+        recordButtonEvents(self);
+    }
+    const float crankChange = input.crankChange;
+    if (!input.current && !input.pushed && !input.released && crankChange == 0.0f) {
+        recorderBeginRecord(self, kRecordIdleFrame, input.time);
+        return;
+    }
+    recorderBeginRecord(self, crankChange != 0.0f ? kRecordCrankFrame : kRecordFrame, input.time);
+    const uint8_t buttons[] = {input.current, input.pushed, input.released};
+    recorderWrite(self, buttons, sizeof(buttons));
+    if (crankChange != 0.0f) {
+        recorderWriteFloat(self, crankChange);
+    }
+}
+
+static void recordEvent(PDKeyboard * _Nonnull self, PDKeyboardRecordTag tag) {
+    recorderBeginRecord(self, tag, playdate->system->getCurrentTimeMilliseconds());
+}
+
+static void recordInputMode(PDKeyboard * _Nonnull self) {
+    recordEvent(self, kRecordInputMode);
+    const uint8_t inputMode = self->inputMode;
+    recorderWrite(self, &inputMode, 1);
+}
+
+static void recordCrankProfile(PDKeyboard * _Nonnull self) {
+    recordEvent(self, kRecordCrankProfile);
+    recorderWriteFloat(self, self->crankProfile.sensitivity);
+    recorderWriteVarint(self, self->crankProfile.ticksPerRevolution);
+    recorderWriteVarint(self, self->crankProfile.maxClicksPerFrame);
+}
+
+#pragma mark - Idle
+
+static void restoreRefreshRate(PDKeyboard * _Nonnull self) {
+    if (self->idleRefreshRateApplied) {
+        playdate->display->setRefreshRate(self->refreshRate);
+        self->idleRefreshRateApplied = false;
+    }
+}
+
+static bool_t isIdleFrame(PDKeyboard * _Nonnull self) {
+    const PDKeyboardInput *input = &self->input;
+    return !input->current && !input->pushed && !input->released && input->crankChange == 0.0f
+        && !self->runningAnimations
+        && !self->needsDisplay
+        && isLayoutEqual(&self->layout, &self->drawnLayout);
+}
+
+/// @brief Counts the frames without input, animation nor change. Past idleFrameThreshold frames, the
+/// refresh rate is lowered to idleRefreshRate until the next input.
+/// @return true if the keyboard is idle and doesn't need to be drawn.
+static bool_t updateIdleState(PDKeyboard * _Nonnull self) {
+    if (self->idleFrameThreshold == 0) {
+        return false;
+    }
+    if (!isIdleFrame(self)) {
+        self->idleFrameCount = 0;
+        restoreRefreshRate(self);
+        return false;
+    }
+    if (self->idleFrameCount < self->idleFrameThreshold) {
+        self->idleFrameCount++;
+        return false;
+    }
+    if (!self->idleRefreshRateApplied && self->idleRefreshRate > 0.0f) {
+        playdate->display->setRefreshRate(self->idleRefreshRate);
+        self->idleRefreshRateApplied = true;
+    }
+    return true;
 }
 
 #pragma mark - Update
 
+/// @brief Returns the input given by setFrameInput if any, reads the buttons, the crank change and the time otherwise.
+/// The buttons come from the queued events when the button callback is registered.
+static PDKeyboardInput readFrameInput(PDKeyboard * _Nonnull self) {
+    self->frameButtonEventCount = 0;
+    self->usesFrameButtonEvents = false;
+    if (self->buttonCallbackRegistered) {
+        drainButtonEvents(self);
+    }
+    if (self->hasNextInput) {
+        self->hasNextInput = false;
+        return self->nextInput;
+    }
+    PDKeyboardInput input;
+    if (self->buttonCallbackRegistered) {
+        input.current = self->eventButtons;
+        input.pushed = 0;
+        input.released = 0;
+        for (unsigned int index = 0; index < self->frameButtonEventCount; index++) {
+            const PDKeyboardButtonEvent *event = &self->frameButtonEvents[index];
+            if (event->down) {
+                input.pushed |= event->button;
+            } else {
+                input.released |= event->button;
+            }
+        }
+        self->usesFrameButtonEvents = true;
+    } else {
+        playdate->system->getButtonState(&input.current, &input.pushed, &input.released);
+    }
+    // The first frame after show doesn't handle the crank, its change stays pending for the next one.
+    input.crankChange = self->justOpened ? 0.0f : playdate->system->getCrankChange();
+    input.time = playdate->system->getCurrentTimeMilliseconds();
+    return input;
+}
+
 // override on the main playdate.update function so that we can run our animations without requiring timers
 static int keyboardUpdate(void * _Nonnull userdata) {
     PDKeyboard *self = userdata;
 
     if (self->isVisible) {
+        const PDKeyboardInput input = readFrameInput(self);
+        if (!self->justOpened) {
+            const unsigned int elapsed = input.time - self->input.time;
+            self->frameDurationMilliseconds = elapsed < kMaxFrameDurationMilliseconds ? elapsed : kMaxFrameDurationMilliseconds;
+        }
+        self->input = input;
+        self->isUpdating = true;
+        statsBeginFrame(self);
+
+        // Shown before its assets were loaded: one more is loaded during each frame of the slide.
+        continueLoading(self);
+
         enterNewLetterIfNecessary(self);
+        statsEndPhase(self, kKeyboardPhaseEnterNewLetter);
 
-        if (self->currentAnimationType != kAnimationTypeNone) {
-            updateAnimation(self);
+        if (self->runningAnimations) {
+            updateAnimations(self, input.time);
 
-            if (isShowOrHideAnimation(self->currentAnimationType)) {
+            if (isSliding(self)) {
                 if (self->keyboardAnimatingCallback) {
                     self->keyboardAnimatingCallback(self->keyboardAnimatingCallbackUserdata);
                 }
             }
         }
+        statsEndPhase(self, kKeyboardPhaseAnimation);
 
         if (!self->justOpened) {
             checkButtonInputs(self);
-            const float crankChange = playdate->system->getCrankChange();
-            if (crankChange != 0.0f) {
-                keyboardInputCranked(self, crankChange);
+            if (input.crankChange != 0.0f) {
+                keyboardInputCranked(self, input.crankChange);
             }
         } else {
             self->justOpened = false;
         }
+        updateSelectionJiggle(self);
+        layoutKeyboard(self);
+        updateDirtyRect(self);
+        statsEndPhase(self, kKeyboardPhaseInput);
+
+        const int playdateUpdateResult = self->playdateUpdate(self->playdateUpdateUserdata);
+        // The game may have shown or hidden the keyboard.
+        layoutKeyboard(self);
+        updateDirtyRect(self);
+        statsEndPhase(self, kKeyboardPhasePlaydateUpdate);
+
+        // When idle, the keyboard is only drawn again if the game did draw.
+        const bool_t idle = updateIdleState(self);
+        if (!idle || playdateUpdateResult) {
+            drawKeyboard(self);
+        }
+        statsEndPhase(self, kKeyboardPhaseDraw);
+        statsEndFrame(self);
 
-        self->playdateUpdate(self->playdateUpdateUserdata);
-        drawKeyboard(self);
+        if (self->recorder) {
+            recordFrame(self);
+        }
+        self->isUpdating = false;
+        return idle ? playdateUpdateResult : true;
     }
     return true;
 }
 
+#pragma mark - Atlas
+
+// The keyboard atlas packs the assets of the keyboard into a single file, built by the
+// host keyboard-pack tool. It is read with a single read when the assets are loaded, the
+// loose CoreLibs files are used when there is no atlas. Numbers are little endian.
+// Header: "PDKA", version (u8).
+// Each section starts with a tag (u8) and the length of its content in bytes (u32).
+// Images are made of their width (u16), height (u16), a flag (u8) set when they have a
+// mask, then height rows of (width + 7) / 8 bytes of data followed by as many rows of mask
+// when the flag is set. Bits are the ones of getBitmapData: 1 is white, or opaque in the mask.
+
+static const uint8_t kAtlasMagic[] = {'P', 'D', 'K', 'A'};
+static const uint8_t kAtlasVersion = 1;
+static const char kAtlasPath[] = "CoreLibs/assets/keyboard/keyboard.pdka";
+
+typedef enum {
+    /// Font height (u8), first character (u8), glyph count (u8), then the advance (u8) and
+    /// the image of each glyph, as drawn by drawText at (0, 0).
+    kAtlasGlyphs = 1,
+    /// PDKeyboardMenuOption of the image (u8) followed by the image.
+    kAtlasMenuImage = 2,
+    /// PDKeyboardSound (u8), SoundFormat (u8), sample rate (u32) and the sample data up to the end of the section.
+    kAtlasSound = 3,
+} PDKeyboardAtlasTag;
+
+typedef struct {
+    const uint8_t * _Nonnull cursor;
+    const uint8_t * _Nonnull end;
+    bool_t failed;
+} PDKeyboardAtlasReader;
+
+/// @brief Returns the next <em>count</em> bytes of <em>reader</em>, or NULL when there are not enough bytes left.
+static const uint8_t * _Nullable atlasRead(PDKeyboardAtlasReader * _Nonnull reader, unsigned int count) {
+    if (reader->failed || (unsigned int) (reader->end - reader->cursor) < count) {
+        reader->failed = true;
+        return NULL;
+    }
+    const uint8_t *bytes = reader->cursor;
+    reader->cursor += count;
+    return bytes;
+}
+
+static unsigned int atlasReadUInt(PDKeyboardAtlasReader * _Nonnull reader, unsigned int size) {
+    const uint8_t *bytes = atlasRead(reader, size);
+    unsigned int value = 0;
+    for (unsigned int index = 0; bytes && index < size; index++) {
+        value |= bytes[index] << (index * 8);
+    }
+    return value;
+}
+
+static LCDBitmap * _Nullable atlasReadImage(PDKeyboardAtlasReader * _Nonnull reader) {
+    const int width = atlasReadUInt(reader, 2);
+    const int height = atlasReadUInt(reader, 2);
+    const bool_t hasMask = atlasReadUInt(reader, 1);
+    const unsigned int rowbytes = (width + 7) / 8;
+    const uint8_t *data = atlasRead(reader, rowbytes * height);
+    const uint8_t *mask = hasMask ? atlasRead(reader, rowbytes * height) : NULL;
+    if (reader->failed) {
+        return NULL;
+    }
+    LCDBitmap *image = playdate->graphics->newBitmap(width, height, hasMask ? kColorClear : kColorWhite);
+    int imageRowbytes;
+    uint8_t *imageMask, *imageData;
+    playdate->graphics->getBitmapData(image, NULL, NULL, &imageRowbytes, &imageMask, &imageData);
+    for (int y = 0; y < height; y++) {
+        memcpy(imageData + y * imageRowbytes, data + y * rowbytes, rowbytes);
+        if (mask) {
+            memcpy(imageMask + y * imageRowbytes, mask + y * rowbytes, rowbytes);
+        }
+    }
+    return image;
+}
+
+static void atlasReadGlyphs(PDKeyboardAtlasReader * _Nonnull reader) {
+#if kColumnsUseGlyphImages
+    atlasFontHeight = atlasReadUInt(reader, 1);
+    const unsigned int firstCharacter = atlasReadUInt(reader, 1);
+    const unsigned int glyphCount = atlasReadUInt(reader, 1);
+    for (unsigned int character = firstCharacter; character < firstCharacter + glyphCount && !reader->failed; character++) {
+        const uint8_t advance = atlasReadUInt(reader, 1);
+        LCDBitmap *image = atlasReadImage(reader);
+        if (character < kAtlasGlyphCapacity && atlasGlyphImages[character] == NULL) {
+            atlasGlyphImages[character] = image;
+            atlasGlyphAdvances[character] = advance;
+        } else if (image) {
+            playdate->graphics->freeBitmap(image);
+        }
+    }
+#else
+    // The text renderer draws with the font, glyph images are not read.
+#endif
+}
+
+static void atlasReadMenuImage(PDKeyboardAtlasReader * _Nonnull reader) {
+    const unsigned int index = atlasReadUInt(reader, 1);
+    if (index >= kMenuColumnCount || menuColumn[index]) {
+        reader->failed = true;
+        return;
+    }
+    menuColumn[index] = atlasReadImage(reader);
+}
+
+static void atlasReadSound(PDKeyboardAtlasReader * _Nonnull reader) {
+    const unsigned int sound = atlasReadUInt(reader, 1);
+    const SoundFormat format = atlasReadUInt(reader, 1);
+    const uint32_t sampleRate = atlasReadUInt(reader, 4);
+    const int byteCount = (int) (reader->end - reader->cursor);
+    const uint8_t *data = atlasRead(reader, byteCount);
+    if (reader->failed || sound >= kSoundCount || atlasSounds[sound].data) {
+        reader->failed = true;
+        return;
+    }
+    PDKeyboardAtlasSound *atlasSound = &atlasSounds[sound];
+    *atlasSound = (PDKeyboardAtlasSound) {
+        .data = playdate->system->realloc(NULL, byteCount),
+        .format = format,
+        .sampleRate = sampleRate,
+        .byteCount = byteCount,
+    };
+    memcpy(atlasSound->data, data, byteCount);
+}
+
+/// @brief Frees the menu images, the sounds read from the atlas and its glyphs if they are still loaded.
+static void unloadAtlas(void) {
+#if kColumnsUseGlyphImages
+    freeAtlasGlyphs();
+#endif
+    for (unsigned int index = 0; index < kMenuColumnCount; index++) {
+        if (menuColumn[index]) {
+            playdate->graphics->freeBitmap(menuColumn[index]);
+            menuColumn[index] = NULL;
+        }
+    }
+    for (unsigned int sound = 0; sound < kSoundCount; sound++) {
+        if (atlasSounds[sound].data) {
+            playdate->system->realloc(atlasSounds[sound].data, 0);
+            atlasSounds[sound].data = NULL;
+        }
+    }
+}
+
+static bool_t parseAtlas(const uint8_t * _Nonnull bytes, unsigned int count) {
+    PDKeyboardAtlasReader reader = {
+        .cursor = bytes,
+        .end = bytes + count,
+    };
+    const uint8_t *magic = atlasRead(&reader, sizeof(kAtlasMagic));
+    if (magic == NULL || memcmp(magic, kAtlasMagic, sizeof(kAtlasMagic)) != 0 || atlasReadUInt(&reader, 1) != kAtlasVersion) {
+        return false;
+    }
+    while (!reader.failed && reader.cursor < reader.end) {
+        const PDKeyboardAtlasTag tag = atlasReadUInt(&reader, 1);
+        const unsigned int length = atlasReadUInt(&reader, 4);
+        const uint8_t *content = atlasRead(&reader, length);
+        if (content == NULL) {
+            break;
+        }
+        PDKeyboardAtlasReader section = {
+            .cursor = content,
+            .end = content + length,
+        };
+        switch (tag) {
+            case kAtlasGlyphs:
+                atlasReadGlyphs(&section);
+                break;
+            case kAtlasMenuImage:
+                atlasReadMenuImage(&section);
+                break;
+            case kAtlasSound:
+                atlasReadSound(&section);
+                break;
+            default:
+                // Sections added by later versions are skipped.
+                break;
+        }
+        if (section.failed) {
+            return false;
+        }
+    }
+    for (unsigned int index = 0; index < kMenuColumnCount; index++) {
+        if (menuColumn[index] == NULL) {
+            return false;
+        }
+    }
+    return !reader.failed;
+}
+
+/// @brief Reads the keyboard atlas with a single read.
+/// @return false when there is no atlas or when it is invalid, nothing is loaded from it in this case.
+static bool_t loadAtlas(void) {
+    FileStat stat;
+    if (playdate->file->stat(kAtlasPath, &stat) != 0 || stat.isdir || stat.size == 0) {
+        return false;
+    }
+    uint8_t *bytes = playdate->system->realloc(NULL, stat.size);
+    SDFile *file = playdate->file->open(kAtlasPath, kFileRead);
+    int readCount = -1;
+    if (file) {
+        readCount = playdate->file->read(file, bytes, stat.size);
+        playdate->file->close(file);
+    }
+    const bool_t loaded = readCount == (int) stat.size && parseAtlas(bytes, stat.size);
+    playdate->system->realloc(bytes, 0);
+    if (!loaded) {
+        playdate->system->logToConsole("Invalid keyboard atlas at path %s, the CoreLibs assets are used instead", kAtlasPath);
+        unloadAtlas();
+    }
+    return loaded;
+}
+
 #pragma mark - Resources
 
 static LCDBitmap * _Nonnull loadBitmapOrError(const char * _Nonnull path) {
@@ -997,28 +2953,149 @@ static LCDBitmap * _Nonnull loadBitmapOrError(const char * _Nonnull path) {
     return bitmap;
 }
 
+static const char * _Nonnull const menuImagePaths[kMenuColumnCount] = {
+    [kMenuOptionSpace] = "CoreLibs/assets/keyboard/menu-space",
+    [kMenuOptionOK] = "CoreLibs/assets/keyboard/menu-ok",
+    [kMenuOptionDelete] = "CoreLibs/assets/keyboard/menu-del",
+    [kMenuOptionCancel] = "CoreLibs/assets/keyboard/menu-cancel",
+};
+
+/// Whether the menu images and the glyphs were read from the atlas by the first step.
+static PDKEYBOARD_THREAD_LOCAL bool_t assetsHaveAtlas;
+
+/// @brief Runs the given loading step.
+/// @return true when something was loaded, false when the step had nothing to do.
+static bool_t runAssetsStep(unsigned int step) {
+    if (step == kAssetsStepAtlas) {
+        assetsHaveAtlas = loadAtlas();
+        return assetsHaveAtlas;
+    }
+    if (step == kAssetsStepFont) {
+#if kColumnsUseGlyphImages
+        if (assetsHaveAtlas && hasAtlasGlyphs()) {
+            fontHeight = atlasFontHeight;
+            return false;
+        }
+#endif
+        const char *error = NULL;
+        keyboardFont = playdate->graphics->loadFont("CoreLibs/assets/keyboard/Roobert-24-Keyboard-Medium", &error);
+        if (error) {
+            playdate->system->error("Unable to load font: %s", error);
+        }
+        fontHeight = playdate->graphics->getFontHeight(keyboardFont);
+        return true;
+    }
+    if (step < kAssetsStepColumns) {
+        const unsigned int index = step - kAssetsStepMenuImages;
+        if (!assetsHaveAtlas) {
+            menuColumn[index] = loadBitmapOrError(menuImagePaths[index]);
+        }
+#if PDKEYBOARD_FRAMEBUFFER
+        initMask(&menuMasks[index], menuColumn[index]);
+#else
+        playdate->graphics->getBitmapData(menuColumn[index], &menuImageSizes[index].width, &menuImageSizes[index].height, NULL, NULL, NULL);
+#endif
+        return !assetsHaveAtlas;
+    }
+    const unsigned int column = step - kAssetsStepColumns;
+    loadColumn(column);
+    if (column == kColumnMenu - 1) {
+#if kColumnsUseGlyphImages
+        freeAtlasGlyphs();
+#endif
+        menuImageSpace = menuColumn[kMenuOptionSpace];
+        menuImageOK = menuColumn[kMenuOptionOK];
+        menuImageDelete = menuColumn[kMenuOptionDelete];
+        menuImageCancel = menuColumn[kMenuOptionCancel];
+    }
+    return true;
+}
+
+/// @brief Runs the loading steps until one of them loads something.
+/// @return true when every asset is loaded.
+static bool_t loadNextAsset(void) {
+    bool_t didLoad = false;
+    while (!didLoad && assetsLoadStep < kAssetsStepCount) {
+        didLoad = runAssetsStep(assetsLoadStep++);
+    }
+    return assetsLoadStep == kAssetsStepCount;
+}
+
 static void loadFontAndImages(void) {
-    if (keyboardFont) {
+    while (!loadNextAsset()) {
+        // Next step.
+    }
+}
+
+/// @brief Loads the next shared asset of a keyboard created with newKeyboardNonBlocking and calls its ready callback once every asset is loaded.
+static void continueLoading(PDKeyboard * _Nonnull self) {
+    if (self->isReady) {
         return;
     }
-    const char *error = NULL;
-    keyboardFont = playdate->graphics->loadFont("CoreLibs/assets/keyboard/Roobert-24-Keyboard-Medium", &error);
-    if (error) {
-        playdate->system->error("Unable to load font: %s", error);
+    const bool_t isLoaded = loadNextAsset();
+    // What was drawn until now lacks the assets that were not loaded yet.
+    self->renderList.isValid = false;
+#if !PDKEYBOARD_FRAMEBUFFER
+    self->keyboardImageIsValid = false;
+#endif
+    self->needsDisplay = true;
+    if (isLoaded) {
+        self->isReady = true;
+        if (self->keyboardReadyCallback) {
+            self->keyboardReadyCallback(self->keyboardReadyCallbackUserdata);
+        }
+    }
+}
+
+static void unloadFontAndImages(void) {
+    if (assetsLoadStep == 0) {
+        return;
+    }
+    assetsLoadStep = 0;
+    unloadColumns();
+    for (unsigned int index = 0; index < kMenuColumnCount; index++) {
+#if PDKEYBOARD_FRAMEBUFFER
+        freeMask(&menuMasks[index]);
+#endif
+    }
+    unloadAtlas();
+    menuImageSpace = NULL;
+    menuImageOK = NULL;
+    menuImageDelete = NULL;
+    menuImageCancel = NULL;
+    if (keyboardFont) {
+        // There is no freeFont, fonts returned by loadFont are freed with realloc.
+        playdate->system->realloc(keyboardFont, 0);
+        keyboardFont = NULL;
+    }
+}
+
+/// Number of keyboards using the font and images, plus one while they are preloaded.
+static PDKEYBOARD_THREAD_LOCAL unsigned int assetsRetainCount;
+static PDKEYBOARD_THREAD_LOCAL bool_t assetsPreloaded;
+
+/// @param loadNow true to finish loading the assets now, false to let continueLoading load them one at a time.
+static void retainAssets(bool_t loadNow) {
+    assetsRetainCount++;
+    if (loadNow) {
+        loadFontAndImages();
+    }
+}
+
+static void releaseAssets(void) {
+    if (assetsRetainCount > 0 && --assetsRetainCount == 0) {
+        unloadFontAndImages();
     }
-    fontHeight = playdate->graphics->getFontHeight(keyboardFont);
-    menuColumn[0] = menuImageSpace = loadBitmapOrError("CoreLibs/assets/keyboard/menu-space");
-    menuColumn[1] = menuImageOK = loadBitmapOrError("CoreLibs/assets/keyboard/menu-ok");
-    menuColumn[2] = menuImageDelete = loadBitmapOrError("CoreLibs/assets/keyboard/menu-del");
-    menuColumn[3] = menuImageCancel = loadBitmapOrError("CoreLibs/assets/keyboard/menu-cancel");
 }
 
 #pragma mark - Public functions
 
-static PDKeyboard * _Nonnull PDKeyboardNew(void) {
+static PDKeyboard * _Nonnull newKeyboard(bool_t loadsAssetsIncrementally) {
     PDKeyboard *self = playdate->system->realloc(NULL, sizeof(PDKeyboard));
 
-    loadFontAndImages();
+    retainAssets(!loadsAssetsIncrementally);
+    buildSlideTables();
+    buildCrankAccelerationTable();
     const int selectionY = displayHeight / 2 - rowHeight / 2 - 2;
     const PDKeyboardColumn selectedColumn = kColumnUpper;
 
@@ -1032,11 +3109,12 @@ static PDKeyboard * _Nonnull PDKeyboardNew(void) {
         .isVisible = false,
         .justOpened = true,
 
-        .currentAnimationType = kAnimationTypeNone,
-
         // TODO: Ideally, would be retrieved with playdate->display->getRefreshRate()
         .refreshRate = 30.0f,
-        .frameRateAdjustedScrollRepeatDelay = 6,
+        .frameDurationMilliseconds = 34,
+
+        .crankProfile = defaultCrankProfile,
+        .clickDegrees = 360.0f / defaultCrankProfile.ticksPerRevolution,
 
         .selectionY = selectionY,
 
@@ -1062,15 +3140,59 @@ static PDKeyboard * _Nonnull PDKeyboardNew(void) {
         },
 
         .text = {},
+        .needsDisplay = true,
+        .isReady = !loadsAssetsIncrementally,
     };
     return self;
 }
 
+static PDKeyboard * _Nonnull PDKeyboardNew(void) {
+    return newKeyboard(false);
+}
+
+static PDKeyboard * _Nonnull PDKeyboardNewNonBlocking(void) {
+    return newKeyboard(true);
+}
+
+static void PDKeyboardStopRecording(PDKeyboard * _Nonnull self);
+
 static void PDKeyboardFree(PDKeyboard * _Nonnull self) {
+    restoreRefreshRate(self);
+    restoreButtonCallback(self);
+    PDKeyboardStopRecording(self);
     PDKeyboardMutableTextFree(&self->text);
     PDKeyboardTextFree(&self->originalText);
     freeSounds(self);
+#if !PDKEYBOARD_FRAMEBUFFER
+    if (self->keyboardImage) {
+        playdate->graphics->freeBitmap(self->keyboardImage);
+    }
+#endif
     playdate->system->realloc(self, 0);
+    releaseAssets();
+}
+
+static void PDKeyboardPreloadAssets(void) {
+    if (!assetsPreloaded) {
+        assetsPreloaded = true;
+        retainAssets(true);
+    }
+}
+
+static void PDKeyboardPurgeAssets(void) {
+    if (assetsPreloaded) {
+        assetsPreloaded = false;
+        releaseAssets();
+    }
+}
+
+static int PDKeyboardContinueLoading(PDKeyboard * _Nonnull self) {
+    continueLoading(self);
+    return self->isReady;
+}
+
+static int PDKeyboardIsReady(PDKeyboard * _Nonnull self) {
+    return self->isReady;
 }
 
 static void PDKeyboardShow(PDKeyboard * _Nonnull self, const char * _Nullable newText, const unsigned int newTextLength) {
@@ -1083,6 +3205,14 @@ static void PDKeyboardShow(PDKeyboard * _Nonnull self, const char * _Nullable ne
         return;
     }
 
+    if (self->recorder) {
+        recordEvent(self, kRecordShow);
+        recorderWriteVarint(self, newText ? newTextLength : 0);
+        if (newText) {
+            recorderWrite(self, newText, newTextLength);
+        }
+    }
+
     self->justOpened = true;
 
     self->okButtonPressed = false;
@@ -1094,6 +3224,7 @@ static void PDKeyboardShow(PDKeyboard * _Nonnull self, const char * _Nullable ne
     self->selectedCharacterRect.size.width = columnWidths[self->selectedColumn];
 
     self->originalText.data = playdate->system->realloc(self->originalText.data, newTextLength + 1);
+    statsCountTextRealloc(self);
     memcpy(self->originalText.data, newText, newTextLength * sizeof(char));
     self->originalText.data[newTextLength] = '\0';
     self->originalText.count = newTextLength;
@@ -1105,22 +3236,40 @@ static void PDKeyboardShow(PDKeyboard * _Nonnull self, const char * _Nullable ne
 
     playdate->system->setUpdateCallback(keyboardUpdate, self);
 
-    if (self->currentAnimationType != kAnimationTypeNone) {
-        // force the previous animation to finish
-        self->animationStartTime = 0;
-        updateAnimation(self);
+    if (self->soundResidency != kSoundResidencyOnDemand) {
+        loadSounds(self);
     }
 
-    const float scrollDelaySeconds = 0.18f;
-    self->frameRateAdjustedScrollRepeatDelay = floorf(scrollDelaySeconds * self->refreshRate);
+    // force the previous animations to finish
+    finishAnimations(self);
+    if (self->inputMode == kInputModeButtonCallback) {
+        registerButtonCallback(self);
+    }
 
     self->isVisible = true;
-    startAnimation(self, kAnimationTypeKeyboardShow, 220);
+    self->needsDisplay = true;
+    const unsigned int now = getCurrentTime(self);
+    startAnimation(self, kAnimationChannelSlide, (PDKeyboardAnimation) {
+        .type = kAnimationTypeKeyboardShow,
+        .easing = kEasingShowSlide,
+        .startTime = now,
+        .duration = kSlideAnimationDuration,
+        .from = displayWidth,
+        .to = displayWidth - keyboardWidth,
+    }, now);
 }
 
-static void PDKeyboardHide(PDKeyboard * _Nonnull self) {
-    if (self->isVisible && self->currentAnimationType == kAnimationTypeNone) {
-        startAnimation(self, kAnimationTypeKeyboardHide, 220);
+static void startHideAnimation(PDKeyboard * _Nonnull self) {
+    if (self->isVisible && !isSliding(self)) {
+        const unsigned int now = getCurrentTime(self);
+        startAnimation(self, kAnimationChannelSlide, (PDKeyboardAnimation) {
+            .type = kAnimationTypeKeyboardHide,
+            .easing = kEasingHideSlide,
+            .startTime = now,
+            .duration = kSlideAnimationDuration,
+            .from = displayWidth - keyboardWidth,
+            .to = displayWidth,
+        }, now);
 
         if (self->keyboardWillHideCallback) {
             self->keyboardWillHideCallback(self->okButtonPressed, self->keyboardWillHideCallbackUserdata);
@@ -1132,15 +3281,30 @@ static void PDKeyboardSetPlaydateUpdateCallback(PDKeyboard * _Nonnull self, PDCa
     self->playdateUpdate = callback;
     self->playdateUpdateUserdata = userdata;
 }
+static void PDKeyboardHide(PDKeyboard * _Nonnull self) {
+    if (self->recorder) {
+        recordEvent(self, kRecordHide);
+    }
+    startHideAnimation(self);
+}
+
 static void PDKeyboardSetRefreshRate(PDKeyboard * _Nonnull self, float refreshRate) {
-    const float scrollDelaySeconds = 0.18f;
+    if (self->recorder) {
+        recordEvent(self, kRecordRefreshRate);
+        recorderWriteFloat(self, refreshRate);
+    }
     self->refreshRate = refreshRate;
-    self->frameRateAdjustedScrollRepeatDelay = floorf(scrollDelaySeconds * refreshRate);
+    // 0 means unlimited: the duration is not known until frames are measured.
+    self->frameDurationMilliseconds = refreshRate > 0.0f
+        ? fminf(ceilf(1000 / refreshRate), kMaxFrameDurationMilliseconds)
+        : kMaxFrameDurationMilliseconds;
+    // When the idle refresh rate is applied, the new rate is set by the next input.
 }
 
 static void PDKeyboardGetText(PDKeyboard * _Nonnull self, char * _Nonnull * _Nullable text, unsigned int * _Nullable count) {
     const unsigned int charCount = self->text.super.count;
     char *data = playdate->system->realloc(*text, (charCount + 1) * sizeof(char));
+    statsCountTextRealloc(self);
     memcpy(data, self->text.super.data, charCount * sizeof(char));
     data[charCount] = '\0';
     *text = data;
@@ -1167,9 +3331,201 @@ static void PDKeyboardSetCapitalizationBehavior(PDKeyboard * _Nonnull self, PDKe
     if (behavior < kCapitalizationNormal || behavior > kCapitalizationSentences) {
         playdate->system->error("Please use one of the following options: playdate.keyboard.kCapitalizationNormal, playdate.keyboard.kCapitalizationWords, playdate.keyboard.kCapitalizationSentences");
     }
+    if (self->recorder) {
+        recordEvent(self, kRecordCapitalization);
+        const uint8_t value = behavior;
+        recorderWrite(self, &value, 1);
+    }
     self->capitalizationBehavior = behavior;
 }
 
+static int PDKeyboardStartRecording(PDKeyboard * _Nonnull self, const char * _Nonnull path) {
+    PDKeyboardStopRecording(self);
+
+    SDFile *file = playdate->file->open(path, kFileWrite);
+    if (file == NULL) {
+        playdate->system->logToConsole("Unable to open keyboard recording at path %s: %s", path, playdate->file->geterr());
+        return -1;
+    }
+    PDKeyboardRecorder *recorder = playdate->system->realloc(NULL, sizeof(PDKeyboardRecorder));
+    *recorder = (PDKeyboardRecorder) {
+        .file = file,
+        .lastTime = playdate->system->getCurrentTimeMilliseconds(),
+    };
+    self->recorder = recorder;
+
+    recorderWrite(self, kRecordingMagic, sizeof(kRecordingMagic));
+    recorderWrite(self, &kRecordingVersion, 1);
+    recorderWriteUInt32(self, recorder->lastTime);
+    recorderWriteFloat(self, self->refreshRate);
+    const uint8_t capitalizationBehavior = self->capitalizationBehavior;
+    recorderWrite(self, &capitalizationBehavior, 1);
+    if (self->slideStyle != kSlideStyleStretchedColumns) {
+        recordEvent(self, kRecordSlideStyle);
+        const uint8_t slideStyle = self->slideStyle;
+        recorderWrite(self, &slideStyle, 1);
+    }
+    if (memcmp(&self->crankProfile, &defaultCrankProfile, sizeof(PDKeyboardCrankProfile))) {
+        recordCrankProfile(self);
+    }
+    if (self->inputMode != kInputModePolling) {
+        recordInputMode(self);
+    }
+    return 0;
+}
+
+static void PDKeyboardStopRecording(PDKeyboard * _Nonnull self) {
+    PDKeyboardRecorder *recorder = self->recorder;
+    if (recorder == NULL) {
+        return;
+    }
+    recorderFlush(self);
+    playdate->file->close(recorder->file);
+    playdate->system->realloc(recorder, 0);
+    self->recorder = NULL;
+}
+
+static int PDKeyboardGetStats(PDKeyboard * _Nonnull self, PDKeyboardStats * _Nonnull stats) {
+    *stats = (PDKeyboardStats) {};
+#if PDKEYBOARD_STATS
+    static const float histogramBounds[] = kKeyboardFrameHistogramBounds;
+    const unsigned int frameCount = self->stats.frameCount;
+    for (unsigned int index = 0; index < frameCount; index++) {
+        const PDKeyboardFrameStats *frame = &self->stats.frames[index];
+        const bool_t first = index == 0;
+        for (unsigned int phase = 0; phase < kKeyboardPhaseCount; phase++) {
+            statValueAdd(&stats->phaseMilliseconds[phase], frame->phaseMilliseconds[phase], first);
+        }
+        statValueAdd(&stats->frameMilliseconds, frame->frameMilliseconds, first);
+        statValueAdd(&stats->textReallocs, frame->textReallocs, first);
+        statValueAdd(&stats->sampleLoads, frame->sampleLoads, first);
+        statValueAdd(&stats->drawCalls, frame->drawCalls, first);
+
+        unsigned int bucket = 0;
+        while (bucket < kKeyboardFrameHistogramSize - 1 && frame->frameMilliseconds >= histogramBounds[bucket]) {
+            bucket++;
+        }
+        stats->frameHistogram[bucket]++;
+    }
+    if (frameCount > 0) {
+        for (unsigned int phase = 0; phase < kKeyboardPhaseCount; phase++) {
+            stats->phaseMilliseconds[phase].average /= frameCount;
+        }
+        stats->frameMilliseconds.average /= frameCount;
+        stats->textReallocs.average /= frameCount;
+        stats->sampleLoads.average /= frameCount;
+        stats->drawCalls.average /= frameCount;
+    }
+    stats->frameCount = frameCount;
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+static void PDKeyboardSetDirtyRectTrackingEnabled(PDKeyboard * _Nonnull self, int enabled) {
+    self->dirtyRectTracking = enabled;
+    self->needsDisplay = true;
+}
+
+static LCDRect PDKeyboardGetDirtyRect(PDKeyboard * _Nonnull self) {
+    return self->isVisible ? self->dirtyRect : (LCDRect) {};
+}
+
+static void PDKeyboardSetNeedsDisplay(PDKeyboard * _Nonnull self) {
+    self->needsDisplay = true;
+    self->dirtyRect = (LCDRect) {
+        .left = self->keyboardRect.origin.x,
+        .right = displayWidth,
+        .top = 0,
+        .bottom = displayHeight,
+    };
+}
+
+static void PDKeyboardSetIdleBehavior(PDKeyboard * _Nonnull self, unsigned int frameCount, float refreshRate) {
+    self->idleFrameThreshold = frameCount;
+    self->idleRefreshRate = refreshRate;
+    self->idleFrameCount = 0;
+    restoreRefreshRate(self);
+}
+
+static void PDKeyboardSetSoundResidency(PDKeyboard * _Nonnull self, PDKeyboardSoundResidency soundResidency) {
+    self->soundResidency = soundResidency;
+    if (!self->isVisible && soundResidency != kSoundResidencyRetained) {
+        freeSounds(self);
+    }
+}
+
+static void PDKeyboardReleaseSounds(PDKeyboard * _Nonnull self) {
+    freeSounds(self);
+}
+
+static void PDKeyboardSetSoundBackend(PDKeyboard * _Nonnull self, PDKeyboardSoundBackend soundBackend) {
+    if (soundBackend == self->soundBackend) {
+        return;
+    }
+    freeSounds(self);
+    self->soundBackend = soundBackend;
+    if (self->isVisible && self->soundResidency != kSoundResidencyOnDemand) {
+        loadSounds(self);
+    }
+}
+
+static void PDKeyboardGetCrankProfile(PDKeyboard * _Nonnull self, PDKeyboardCrankProfile * _Nonnull crankProfile) {
+    *crankProfile = self->crankProfile;
+}
+
+static void PDKeyboardSetCrankProfile(PDKeyboard * _Nonnull self, const PDKeyboardCrankProfile * _Nonnull crankProfile) {
+    const unsigned int maxClicksPerFrame = crankProfile->maxClicksPerFrame;
+    self->crankProfile = (PDKeyboardCrankProfile) {
+        .sensitivity = crankProfile->sensitivity,
+        .ticksPerRevolution = crankProfile->ticksPerRevolution > 0 ? crankProfile->ticksPerRevolution : 1,
+        .maxClicksPerFrame = maxClicksPerFrame == 0 ? 1 : maxClicksPerFrame > UINT8_MAX ? UINT8_MAX : maxClicksPerFrame,
+    };
+    self->clickDegrees = 360.0f / self->crankProfile.ticksPerRevolution;
+    if (self->recorder) {
+        recordCrankProfile(self);
+    }
+}
+
+static void PDKeyboardGetFrameInput(PDKeyboard * _Nonnull self, PDKeyboardInput * _Nonnull input) {
+    *input = self->input;
+}
+
+static void PDKeyboardSetFrameInput(PDKeyboard * _Nonnull self, const PDKeyboardInput * _Nullable input) {
+    if (input) {
+        self->nextInput = *input;
+    }
+    self->hasNextInput = input != NULL;
+}
+
+static void PDKeyboardSetInputMode(PDKeyboard * _Nonnull self, PDKeyboardInputMode inputMode) {
+    self->inputMode = inputMode;
+    if (self->recorder) {
+        recordInputMode(self);
+    }
+    if (inputMode == kInputModeButtonCallback && self->isVisible) {
+        registerButtonCallback(self);
+    } else {
+        restoreButtonCallback(self);
+    }
+}
+
+static void PDKeyboardSetPlaydateButtonCallback(PDKeyboard * _Nonnull self, PDButtonCallbackFunction * _Nullable callback, void * _Nullable userdata, int queueSize) {
+    self->playdateButtonCallback = callback;
+    self->playdateButtonCallbackUserdata = userdata;
+    self->playdateButtonCallbackQueueSize = queueSize;
+}
+
+static void PDKeyboardSetSlideStyle(PDKeyboard * _Nonnull self, PDKeyboardSlideStyle slideStyle) {
+    if (self->recorder) {
+        recordEvent(self, kRecordSlideStyle);
+        const uint8_t value = slideStyle;
+        recorderWrite(self, &value, 1);
+    }
+    self->slideStyle = slideStyle;
+}
+
 static void PDKeyboardSetKeyboardDidShowCallback(PDKeyboard * _Nonnull self, PDKeyboardCallback * _Nullable callback, void * _Nullable userdata) {
     self->keyboardDidShowCallback = callback;
     self->keyboardDidShowCallbackUserdata = userdata;
@@ -1190,6 +3546,11 @@ static void PDKeyboardSetKeyboardAnimatingCallback(PDKeyboard * _Nonnull self, P
     self->keyboardAnimatingCallbackUserdata = userdata;
 }
 
+static void PDKeyboardSetKeyboardReadyCallback(PDKeyboard * _Nonnull self, PDKeyboardCallback * _Nullable callback, void * _Nullable userdata) {
+    self->keyboardReadyCallback = callback;
+    self->keyboardReadyCallbackUserdata = userdata;
+}
+
 static void PDKeyboardSetTextChangedCallback(PDKeyboard * _Nonnull self, PDKeyboardCallback * _Nullable callback, void * _Nullable userdata) {
     self->textChangedCallback = callback;
     self->textChangedCallbackUserdata = userdata;
@@ -1202,6 +3563,13 @@ const struct pd_keyboard keyboardApi = (struct pd_keyboard) {
     .newKeyboard = PDKeyboardNew,
     .freeKeyboard = PDKeyboardFree,
 
+    .preloadAssets = PDKeyboardPreloadAssets,
+    .purgeAssets = PDKeyboardPurgeAssets,
+
+    .newKeyboardNonBlocking = PDKeyboardNewNonBlocking,
+    .continueLoading = PDKeyboardContinueLoading,
+    .isReady = PDKeyboardIsReady,
+
     .setPlaydateUpdateCallback = PDKeyboardSetPlaydateUpdateCallback,
     .setRefreshRate = PDKeyboardSetRefreshRate,
 
@@ -1222,4 +3590,30 @@ const struct pd_keyboard keyboardApi = (struct pd_keyboard) {
     .setKeyboardWillHideCallback = PDKeyboardSetKeyboardWillHideCallback,
     .setKeyboardAnimatingCallback = PDKeyboardSetKeyboardAnimatingCallback,
     .setTextChangedCallback = PDKeyboardSetTextChangedCallback,
+    .setKeyboardReadyCallback = PDKeyboardSetKeyboardReadyCallback,
+
+    .startRecording = PDKeyboardStartRecording,
+    .stopRecording = PDKeyboardStopRecording,
+
+    .getStats = PDKeyboardGetStats,
+
+    .setDirtyRectTrackingEnabled = PDKeyboardSetDirtyRectTrackingEnabled,
+    .getDirtyRect = PDKeyboardGetDirtyRect,
+    .setNeedsDisplay = PDKeyboardSetNeedsDisplay,
+
+    .setIdleBehavior = PDKeyboardSetIdleBehavior,
+
+    .setSlideStyle = PDKeyboardSetSlideStyle,
+
+    .getCrankProfile = PDKeyboardGetCrankProfile,
+    .setCrankProfile = PDKeyboardSetCrankProfile,
+
+    .getFrameInput = PDKeyboardGetFrameInput,
+    .setFrameInput = PDKeyboardSetFrameInput,
+    .setInputMode = PDKeyboardSetInputMode,
+    .setPlaydateButtonCallback = PDKeyboardSetPlaydateButtonCallback,
+
+    .setSoundResidency = PDKeyboardSetSoundResidency,
+    .releaseSounds = PDKeyboardReleaseSounds,
+    .setSoundBackend = PDKeyboardSetSoundBackend,
 };
@@ -10,7 +10,45 @@
 
 #include "pd_api.h"
 
-extern PlaydateAPI * _Nullable playdate;
+/**
+ * Storage class of the global <code>playdate</code> pointer and of the assets
+ * shared by keyboards. Define it as <code>_Thread_local</code> to run keyboards
+ * against a different PlaydateAPI on each thread (see the host fuzz runner).
+ */
+#ifndef PDKEYBOARD_THREAD_LOCAL
+#define PDKEYBOARD_THREAD_LOCAL
+#endif
+
+extern PDKEYBOARD_THREAD_LOCAL PlaydateAPI * _Nullable playdate;
+
+/**
+ * Set to 1 to measure each phase of the keyboard frames and count allocations,
+ * sample loads and draw calls. Statistics are read with <code>keyboardApi.getStats</code>.
+ * When 0, the instrumentation is not compiled.
+ */
+#ifndef PDKEYBOARD_STATS
+#define PDKEYBOARD_STATS 0
+#endif
+
+/**
+ * Set to 0 to draw each letter/symbol column with a single multi-line drawText instead of
+ * pre-rendering the columns into bitmaps when the assets are loaded. Uses less memory but
+ * lays out the text of 3 columns every frame.
+ */
+#ifndef PDKEYBOARD_COLUMN_STRIPS
+#define PDKEYBOARD_COLUMN_STRIPS 1
+#endif
+
+/**
+ * Set to 1 to draw the keyboard directly into the frame buffer returned by
+ * <code>playdate->graphics->getFrame()</code> instead of using the graphics functions.
+ * Glyphs and menu images are converted into 1-bit masks when the assets are loaded.
+ * The draw offset and clip rect set by the game are ignored. Takes precedence over
+ * <code>PDKEYBOARD_COLUMN_STRIPS</code>.
+ */
+#ifndef PDKEYBOARD_FRAMEBUFFER
+#define PDKEYBOARD_FRAMEBUFFER 0
+#endif
 
 typedef struct pdkeyboard PDKeyboard;
 
@@ -20,6 +58,111 @@ typedef enum {
     kCapitalizationSentences,
 } PDKeyboardCapitalization;
 
+/**
+ * Look of the show/hide slide. Both are drawn from an image of the opened keyboard rendered when the slide starts.
+ */
+typedef enum {
+    /// Columns are spread with the width of the keyboard, like the Lua keyboard.
+    kSlideStyleStretchedColumns,
+    /// The opened keyboard slides as a whole.
+    kSlideStyleSolid,
+} PDKeyboardSlideStyle;
+
+/**
+ * When the sound samples of a keyboard are loaded and freed.
+ */
+typedef enum {
+    /// Loaded by <code>show</code> and kept until the keyboard is freed or <code>releaseSounds</code> is called.
+    kSoundResidencyRetained,
+    /// Loaded by <code>show</code> and freed at the end of the hide animation.
+    kSoundResidencyWhileVisible,
+    /// Loaded when first played and freed when the keyboard is closed from its menu, like the Lua keyboard.
+    kSoundResidencyOnDemand,
+} PDKeyboardSoundResidency;
+
+/**
+ * How the keyboard sounds are played.
+ */
+typedef enum {
+    /// The sfx samples of CoreLibs, loaded from the <code>Source</code> folder.
+    kSoundBackendSamples,
+    /// Clicks and blips generated with <code>playdate->sound->synth</code>, without any file.
+    kSoundBackendSynth,
+} PDKeyboardSoundBackend;
+
+/**
+ * How the crank moves the selection of the letter and symbol columns. The crank change of each frame is
+ * accelerated, multiplied by <code>sensitivity</code> then converted to rows.
+ */
+typedef struct {
+    /// Defaults to 1.
+    float sensitivity;
+    /// Rows moved by a revolution of the crank before acceleration. Defaults to 15.
+    unsigned int ticksPerRevolution;
+    /// Maximum number of rows moved by a single frame. Defaults to 42, the length of the symbols column.
+    unsigned int maxClicksPerFrame;
+} PDKeyboardCrankProfile;
+
+/**
+ * Buttons, crank change and time of a frame, read once at the start of each keyboard update.
+ */
+typedef struct {
+    /// Same values as <code>playdate->system->getButtonState</code>.
+    PDButtons current;
+    PDButtons pushed;
+    PDButtons released;
+    /// Same value as <code>playdate->system->getCrankChange</code>.
+    float crankChange;
+    /// Time of the frame in milliseconds, like <code>playdate->system->getCurrentTimeMilliseconds</code>.
+    unsigned int time;
+} PDKeyboardInput;
+
+typedef enum {
+    /// Reads the button state once per frame with <code>playdate->system->getButtonState</code>.
+    kInputModePolling,
+    /// Registers a button callback while the keyboard is visible: every press and release is handled,
+    /// even when several happen between two frames.
+    kInputModeButtonCallback,
+} PDKeyboardInputMode;
+
+typedef enum {
+    kKeyboardPhaseEnterNewLetter,
+    kKeyboardPhaseAnimation,
+    kKeyboardPhaseInput,
+    kKeyboardPhasePlaydateUpdate,
+    kKeyboardPhaseDraw,
+} PDKeyboardPhase;
+#define kKeyboardPhaseCount 5
+
+/**
+ * Upper bounds in milliseconds of the buckets of <code>PDKeyboardStats.frameHistogram</code>.
+ * The last bucket counts every frame longer than the last bound.
+ */
+#define kKeyboardFrameHistogramBounds {0.5f, 1.0f, 2.0f, 4.0f, 8.0f, 16.0f, 33.0f}
+#define kKeyboardFrameHistogramSize 8
+
+typedef struct {
+    float min;
+    float average;
+    float max;
+} PDKeyboardStatValue;
+
+/**
+ * Statistics of the last <code>frameCount</code> frames where the keyboard was visible.
+ */
+typedef struct {
+    unsigned int frameCount;
+    /// Time spent in each phase of keyboardUpdate, in milliseconds.
+    PDKeyboardStatValue phaseMilliseconds[kKeyboardPhaseCount];
+    /// Time spent in keyboardUpdate, including the playdateUpdate callback, in milliseconds.
+    PDKeyboardStatValue frameMilliseconds;
+    unsigned int frameHistogram[kKeyboardFrameHistogramSize];
+    /// Calls to realloc for the text buffers, per frame.
+    PDKeyboardStatValue textReallocs;
+    PDKeyboardStatValue sampleLoads;
+    PDKeyboardStatValue drawCalls;
+} PDKeyboardStats;
+
 typedef void PDKeyboardCallback(void * _Nullable userdata);
 typedef void PDKeyboardWillHideCallback(int okButtonPressed, void * _Nullable userdata);
 
@@ -27,6 +170,31 @@ struct pd_keyboard {
     PDKeyboard * _Nonnull (* _Nonnull newKeyboard)(void);
     void (* _Nonnull freeKeyboard)(PDKeyboard * _Nonnull keyboard);
 
+    /**
+     * Loads the font and images shared by keyboards and keeps them loaded until <code>purgeAssets</code> is called.
+     * Without it, they are loaded by the first <code>newKeyboard</code> and freed with the last keyboard.
+     */
+    void (* _Nonnull preloadAssets)(void);
+    /**
+     * Cancels <code>preloadAssets</code>: the assets are freed now or when the last keyboard is freed.
+     */
+    void (* _Nonnull purgeAssets)(void);
+
+    /**
+     * Same as <code>newKeyboard</code> but returns without loading the shared assets. Call <code>continueLoading</code> once per frame
+     * to load them one at a time. If the keyboard is shown before, the remaining assets are loaded during the slide.
+     */
+    PDKeyboard * _Nonnull (* _Nonnull newKeyboardNonBlocking)(void);
+    /**
+     * Loads the next asset of a keyboard returned by <code>newKeyboardNonBlocking</code>. Returns 1 once every asset is loaded,
+     * the ready callback is called by the same call.
+     */
+    int (* _Nonnull continueLoading)(PDKeyboard * _Nonnull keyboard);
+    /**
+     * Returns 1 once <code>continueLoading</code> returned 1, or for keyboards created with <code>newKeyboard</code>.
+     */
+    int (* _Nonnull isReady)(PDKeyboard * _Nonnull keyboard);
+
     void (* _Nonnull setPlaydateUpdateCallback)(PDKeyboard * _Nonnull keyboard, PDCallbackFunction * _Nonnull playdateUpdate, void * _Nullable userdata);
     void (* _Nonnull setRefreshRate)(PDKeyboard * _Nonnull keyboard, float refreshRate);
 
@@ -50,6 +218,92 @@ struct pd_keyboard {
     void (* _Nonnull setKeyboardWillHideCallback)(PDKeyboard * _Nonnull keyboard, PDKeyboardWillHideCallback * _Nullable callback, void * _Nullable userdata);
     void (* _Nonnull setKeyboardAnimatingCallback)(PDKeyboard * _Nonnull keyboard, PDKeyboardCallback * _Nullable callback, void * _Nullable userdata);
     void (* _Nonnull setTextChangedCallback)(PDKeyboard * _Nonnull keyboard, PDKeyboardCallback * _Nullable callback, void * _Nullable userdata);
+    /**
+     * Called once the assets of a keyboard returned by <code>newKeyboardNonBlocking</code> are loaded, from <code>continueLoading</code> or from the keyboard update.
+     */
+    void (* _Nonnull setKeyboardReadyCallback)(PDKeyboard * _Nonnull keyboard, PDKeyboardCallback * _Nullable callback, void * _Nullable userdata);
+
+    /**
+     * Records every frame of input seen by the keyboard into the file at <em>path</em>. Returns 0 on success.
+     */
+    int (* _Nonnull startRecording)(PDKeyboard * _Nonnull keyboard, const char * _Nonnull path);
+    void (* _Nonnull stopRecording)(PDKeyboard * _Nonnull keyboard);
+
+    /**
+     * Fills <em>stats</em> with the statistics of the last frames. Returns 0 and clears <em>stats</em> when built without <code>PDKEYBOARD_STATS</code>.
+     * With <code>PDKEYBOARD_STATS</code>, each update of the visible keyboard starts with <code>playdate->system->resetElapsedTime</code>,
+     * frames where <code>playdateUpdate</code> resets it again are dropped.
+     */
+    int (* _Nonnull getStats)(PDKeyboard * _Nonnull keyboard, PDKeyboardStats * _Nonnull stats);
+
+    /**
+     * When enabled, the keyboard only redraws the parts of the screen that changed since the last frame.
+     * The game must not draw over the keyboard area (see <code>getLeft</code>) or must call <code>setNeedsDisplay</code> when it does.
+     */
+    void (* _Nonnull setDirtyRectTrackingEnabled)(PDKeyboard * _Nonnull keyboard, int enabled);
+    /**
+     * Returns the area that the keyboard will redraw during the current frame. Valid from the <code>playdateUpdate</code> callback.
+     * The rect is empty when nothing changed and covers the whole keyboard when dirty rect tracking is disabled.
+     */
+    LCDRect (* _Nonnull getDirtyRect)(PDKeyboard * _Nonnull keyboard);
+    /**
+     * Redraws the whole keyboard during the next draw.
+     */
+    void (* _Nonnull setNeedsDisplay)(PDKeyboard * _Nonnull keyboard);
+
+    /**
+     * After <em>frameCount</em> frames without input nor animation, stops drawing the keyboard and returns the value returned
+     * by <code>playdateUpdate</code> from the update callback. When <em>refreshRate</em> is greater than 0, the display refresh rate is also
+     * lowered to <em>refreshRate</em> until the next button or crank input. A <em>frameCount</em> of 0 disables idle frames.
+     */
+    void (* _Nonnull setIdleBehavior)(PDKeyboard * _Nonnull keyboard, unsigned int frameCount, float refreshRate);
+
+    /**
+     * Changes the look of the show/hide slide. Defaults to <code>kSlideStyleStretchedColumns</code>.
+     */
+    void (* _Nonnull setSlideStyle)(PDKeyboard * _Nonnull keyboard, PDKeyboardSlideStyle slideStyle);
+
+    void (* _Nonnull getCrankProfile)(PDKeyboard * _Nonnull keyboard, PDKeyboardCrankProfile * _Nonnull crankProfile);
+    /**
+     * Changes how the crank moves the selection. <code>ticksPerRevolution</code> and <code>maxClicksPerFrame</code> are raised to 1 when 0,
+     * <code>maxClicksPerFrame</code> is lowered to 255.
+     */
+    void (* _Nonnull setCrankProfile)(PDKeyboard * _Nonnull keyboard, const PDKeyboardCrankProfile * _Nonnull crankProfile);
+
+    /**
+     * Fills <em>input</em> with the input of the current frame. Call it from <code>playdateUpdate</code> instead of reading the buttons
+     * and the crank again: <code>getCrankChange</code> returns 0 once the keyboard read it.
+     */
+    void (* _Nonnull getFrameInput)(PDKeyboard * _Nonnull keyboard, PDKeyboardInput * _Nonnull input);
+    /**
+     * The next update of the visible keyboard uses <em>input</em> instead of reading <code>playdate->system</code>.
+     * <em>NULL</em> cancels the input given earlier.
+     */
+    void (* _Nonnull setFrameInput)(PDKeyboard * _Nonnull keyboard, const PDKeyboardInput * _Nullable input);
+    /**
+     * Changes how the buttons are read. Defaults to <code>kInputModePolling</code>. In <code>kInputModeButtonCallback</code>,
+     * the keyboard replaces the button callback while it is visible and gives back the one set with
+     * <code>setPlaydateButtonCallback</code> when it hides.
+     */
+    void (* _Nonnull setInputMode)(PDKeyboard * _Nonnull keyboard, PDKeyboardInputMode inputMode);
+    /**
+     * Button callback of the game, called by the keyboard for each event while it is visible and registered again
+     * when it hides. <code>playdate->system</code> can't return the current one so the game gives it here.
+     */
+    void (* _Nonnull setPlaydateButtonCallback)(PDKeyboard * _Nonnull keyboard, PDButtonCallbackFunction * _Nullable callback, void * _Nullable userdata, int queueSize);
+
+    /**
+     * Changes when the sound samples are loaded and freed. Defaults to <code>kSoundResidencyRetained</code>.
+     */
+    void (* _Nonnull setSoundResidency)(PDKeyboard * _Nonnull keyboard, PDKeyboardSoundResidency soundResidency);
+    /**
+     * Frees the sound samples now, for example when memory is low. Samples played afterwards are loaded again.
+     */
+    void (* _Nonnull releaseSounds)(PDKeyboard * _Nonnull keyboard);
+    /**
+     * Chooses between the sfx samples and synthesized sounds. Defaults to <code>kSoundBackendSamples</code>.
+     */
+    void (* _Nonnull setSoundBackend)(PDKeyboard * _Nonnull keyboard, PDKeyboardSoundBackend soundBackend);
 };
 
 extern const struct pd_keyboard keyboardApi;